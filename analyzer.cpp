@@ -1,19 +1,576 @@
 #include "analyzer.h"
+#include "csv_tokenizer.h"
+#include "trip_fields.h"
+#include "zone_index.h"
 
 #include <fstream>
+#include <istream>
 #include <string>
+#include <string_view>
 #include <vector>
-#include <unordered_map>
-#include <array>
+#include <cstdint>
+#include <climits>
 #include <algorithm>
 #include <cctype>
+#include <cstring>
+#include <exception>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <cstdio>
+#include <cstdlib>
+#include <cerrno>
+#include <chrono>
+#include <new>
 
-// ============================================================
-// Shared state (because analyzer.h has no private members)
-// Keyed by TripAnalyzer instance pointer.
-// ============================================================
-static std::unordered_map<const TripAnalyzer*, std::unordered_map<std::string, long long>> g_zoneTrips;
-static std::unordered_map<const TripAnalyzer*, std::unordered_map<std::string, std::array<long long, 24>>> g_zoneHourTrips;
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <glob.h>
+#define TRIP_HAVE_MMAP 1
+#else
+#define TRIP_HAVE_MMAP 0
+#endif
+
+// A zone's hour counts (see ZoneTable): the total, then kInlineHours
+// (hour, count) pairs or the dense row's index in count[0]. Snapshots store
+// the same cells and rows.
+struct HourCell {
+    long long total = 0;
+    uint32_t count[3];
+    uint8_t hour[3];
+    uint8_t used = 0; // inline pairs, or kNarrowRow / kWideRow
+};
+static_assert(sizeof(HourCell) == 24, "snapshots store HourCells as they are");
+static const int kInlineHours = 3;
+static const uint8_t kNarrowRow = 0xFE;
+static const uint8_t kWideRow = 0xFF;
+
+// Zone table laid out read-only in a loaded snapshot (see the snapshot
+// section); `keep` holds the mapping or buffer the pointers point into.
+struct FrozenTable {
+    uint32_t count = 0;
+    const HourCell* cells = nullptr;
+    const uint32_t* narrow = nullptr; // narrowRows rows of 24 counters
+    const long long* wide = nullptr;  // wideRows rows of 24 counters
+    size_t narrowRows = 0;
+    size_t wideRows = 0;
+    size_t busyCells = 0;                  // counted while the cells are checked
+    const uint32_t* nameOffsets = nullptr; // count + 1 offsets into names
+    const char* names = nullptr;
+    std::shared_ptr<const void> keep;
+
+    std::string_view name(uint32_t id) const {
+        return std::string_view(names + nameOffsets[id], (size_t)(nameOffsets[id + 1] - nameOffsets[id]));
+    }
+};
+
+// ------------------- ingest statistics -------------------
+//
+// Built only with TRIP_ANALYZER_STATS. TRIP_STAT(x) evaluates x in such a
+// build and is empty otherwise, so the counting below costs nothing when
+// it is off. Each ZoneTable carries its own counters, which keeps them
+// thread-private and lets merge() add them up with the counts.
+
+#ifdef TRIP_ANALYZER_STATS
+#define TRIP_STAT(x) (x)
+#else
+#define TRIP_STAT(x) ((void)0)
+#endif
+
+enum StatPhase { kPhaseRead, kPhaseTokenize, kPhaseHour, kPhaseHash, kPhaseRehash, kPhases };
+enum StatReject { kRejectFields, kRejectEmptyZone, kRejectBadTime, kRejectHourRange, kRejects };
+
+// one row in kStatSample has its phases timed
+static const long long kStatSample = 64;
+
+struct StatCounters {
+    long long bytes = 0;
+    long long rows = 0;
+    long long sampledRows = 0;
+    long long accepted = 0;
+    long long rejects[kRejects] = {};
+    long long phaseNs[kPhases] = {};
+    size_t rehashes = 0; // of tables already folded in
+    long long cacheLookups = 0; // same
+    long long cacheHits = 0;
+
+    void add(const StatCounters& o) {
+        bytes += o.bytes;
+        rows += o.rows;
+        sampledRows += o.sampledRows;
+        accepted += o.accepted;
+        for (int i = 0; i < kRejects; ++i) rejects[i] += o.rejects[i];
+        for (int i = 0; i < kPhases; ++i) phaseNs[i] += o.phaseNs[i];
+        rehashes += o.rehashes;
+        cacheLookups += o.cacheLookups;
+        cacheHits += o.cacheHits;
+    }
+};
+
+#ifdef TRIP_ANALYZER_STATS
+static inline long long statNowNs() {
+    return (long long)std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Cost of one statNowNs() call, taken off every sampled lap so short
+// phases are not dominated by the clock itself.
+static long long statClockNs() {
+    static const long long cost = [] {
+        long long best = 1000;
+        for (int i = 0; i < 64; ++i) {
+            long long t0 = statNowNs();
+            long long t1 = statNowNs();
+            best = std::min(best, t1 - t0);
+        }
+        return best;
+    }();
+    return cost;
+}
+#endif
+
+// ------------------- hot-zone front cache -------------------
+
+// Same bytes? n is at most FrontCache::kMaxKey; overlapping fixed-size loads
+// keep this free of a variable-length memcmp call.
+static inline bool sameKeyBytes(const char* a, const char* b, size_t n) {
+    if (n >= 8) {
+        uint64_t x, y;
+        for (size_t off = 0; off + 8 < n; off += 8) {
+            std::memcpy(&x, a + off, 8);
+            std::memcpy(&y, b + off, 8);
+            if (x != y) return false;
+        }
+        std::memcpy(&x, a + n - 8, 8);
+        std::memcpy(&y, b + n - 8, 8);
+        return x == y;
+    }
+    if (n >= 4) {
+        uint32_t x, y, u, v;
+        std::memcpy(&x, a, 4);
+        std::memcpy(&y, b, 4);
+        std::memcpy(&u, a + n - 4, 4);
+        std::memcpy(&v, b + n - 4, 4);
+        return x == y && u == v;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        if (a[i] != b[i]) return false;
+    }
+    return true;
+}
+
+// The last few dozen zones seen, keyed by their trimmed field bytes as read
+// (before upper-casing) and mapped to their id. Direct-mapped on the length
+// and the key's outer bytes, so a lookup is one slot and one compare, and
+// a hit skips the upper-case copy and the index's full hash and probe. On
+// skewed input a handful of zones make up most rows and nearly all hit.
+//
+// When zones rarely repeat (C1: every row a new zone) each lookup would be
+// a wasted miss, so the cache watches itself: a window of kWindow lookups
+// with under a quarter hits switches it off for the next kBackoff rows, and
+// then it tries again.
+class FrontCache {
+public:
+    static const size_t kMaxKey = 27;
+
+    // Id of the raw zone bytes, or ZoneIndex::kNotFound on a miss or while
+    // switched off.
+    uint32_t find(std::string_view key) {
+        if (key.size() > kMaxKey) return ZoneIndex::kNotFound; // never cached
+        if (idle_ > 0) {
+            --idle_;
+            return ZoneIndex::kNotFound;
+        }
+        if (++lookups_ == windowEnd_) retune();
+        const Entry& e = slots_[slotOf(key)];
+        if (e.len != key.size() || !sameKeyBytes(e.key, key.data(), key.size())) return ZoneIndex::kNotFound;
+        ++hits_;
+        return e.id;
+    }
+
+    // Remember a key that find() missed.
+    void put(std::string_view key, uint32_t id) {
+        if (idle_ > 0 || key.size() > kMaxKey) return;
+        Entry& e = slots_[slotOf(key)];
+        e.id = id;
+        e.len = (uint8_t)key.size();
+        std::memcpy(e.key, key.data(), key.size());
+    }
+
+    void clear() { *this = FrontCache(); }
+
+    long long lookups() const { return lookups_; }
+    long long hits() const { return hits_; }
+
+private:
+    static const size_t kSlots = 64;
+    static const long long kWindow = 1024;
+    static const long long kBackoff = 64 * 1024;
+
+    struct Entry {
+        uint32_t id = 0;
+        uint8_t len = 0xFF; // longer than kMaxKey, so find() never matches it
+        char key[kMaxKey];
+    };
+
+    // mixes the first and last four bytes: zone names tend to differ in a
+    // numeric suffix, spellings of one zone in the case of their first letter
+    static size_t slotOf(std::string_view key) {
+        size_t n = key.size();
+        uint32_t head, tail;
+        if (n >= 4) {
+            std::memcpy(&head, key.data(), 4);
+            std::memcpy(&tail, key.data() + n - 4, 4);
+        } else {
+            head = (uint32_t)(uint8_t)key[0] | ((uint32_t)(uint8_t)key[n - 1] << 8);
+            tail = (uint32_t)(uint8_t)key[n / 2];
+        }
+        uint32_t h = ((head * 0x9E3779B1u) ^ tail ^ (uint32_t)n) * 0x85EBCA77u;
+        return (size_t)(h >> 26) & (kSlots - 1);
+    }
+
+    void retune() {
+        if ((hits_ - windowHits_) * 4 < kWindow) idle_ = kBackoff;
+        windowEnd_ = lookups_ + kWindow;
+        windowHits_ = hits_;
+    }
+
+    Entry slots_[kSlots];
+    long long lookups_ = 0;
+    long long hits_ = 0;
+    long long windowEnd_ = kWindow;
+    long long windowHits_ = 0;
+    long long idle_ = 0;
+};
+
+// Zone dictionary: every distinct zone is interned once and gets a dense id
+// in first-seen order. Counters live in flat arrays indexed by that id, so
+// merging and ranking are linear scans.
+//
+// Hour counts are sparse: in wide data most zones only ever see an hour or
+// two. A zone's 24-byte HourCell holds its total and up to kInlineHours
+// (hour, count) pairs; its next new hour moves it to a dense row of 24
+// counters. Dense rows start out 32-bit and are copied to a 64-bit row when
+// a counter would overflow (an inline count that would overflow goes
+// straight to 64 bits).
+//
+// A table adopted from a snapshot is read in place; the first write copies
+// it into the owned arrays and rebuilds the index, keeping the same ids.
+class ZoneTable {
+public:
+    static const int kHours = 24;
+
+    uint32_t intern(std::string_view zone) {
+        thaw();
+#ifdef TRIP_ANALYZER_STATS
+        // only a new key grows the index, so a lookup that found its zone
+        // (same capacity after) is not charged as a rehash
+        size_t cap = ids_.capacity();
+        long long growStart = ids_.needsGrow() ? statNowNs() : 0;
+        uint32_t id = ids_.intern(zone);
+        if (growStart && ids_.capacity() != cap) stats_.phaseNs[kPhaseRehash] += statNowNs() - growStart;
+#else
+        uint32_t id = ids_.intern(zone);
+#endif
+        if (id == cells_.size()) {
+            cells_.push_back(HourCell());
+        }
+        return id;
+    }
+
+    // Id of a zone by its raw (trimmed, not yet upper-cased) bytes, if the
+    // front cache has it; ZoneIndex::kNotFound otherwise.
+    uint32_t findRaw(std::string_view raw) { return front_.find(raw); }
+    void rememberRaw(std::string_view raw, uint32_t id) { front_.put(raw, id); }
+
+    void add(uint32_t id, int hour) {
+        HourCell& c = cells_[id];
+        c.total++;
+        if (c.used == kNarrowRow) {
+            uint32_t& n = narrow_[(size_t)c.count[0] * kHours + hour];
+            if (n < UINT32_MAX) {
+                busyCells_ += n == 0;
+                n++;
+                return;
+            }
+        } else if (c.used <= kInlineHours) {
+            for (int i = 0; i < c.used; ++i) {
+                if (c.hour[i] == hour && c.count[i] < UINT32_MAX) {
+                    c.count[i]++;
+                    return;
+                }
+            }
+        }
+        addHours(id, hour, 1);
+    }
+
+    // Fold another table in; ids of zones new to this table follow the
+    // other table's first-seen order.
+    void merge(const ZoneTable& other) {
+        thaw();
+#ifdef TRIP_ANALYZER_STATS
+        stats_.add(other.stats_);
+        stats_.rehashes += other.ids_.rehashes();
+        stats_.cacheLookups += other.front_.lookups();
+        stats_.cacheHits += other.front_.hits();
+#endif
+        for (uint32_t i = 0; i < other.size(); ++i) {
+            uint32_t id = intern(other.name(i));
+            cells_[id].total += other.total(i);
+            other.forEachHour(i, [&](int h, long long n) { addHours(id, h, n); });
+        }
+    }
+
+    void clear() {
+        frozen_ = FrozenTable();
+        ids_.clear();
+        cells_.clear();
+        narrow_.clear();
+        wide_.clear();
+        busyCells_ = 0;
+        front_.clear();
+        TRIP_STAT(stats_ = StatCounters());
+    }
+
+    // Serve queries straight from a snapshot's arrays.
+    void adopt(FrozenTable frozen) {
+        clear();
+        frozen_ = std::move(frozen);
+    }
+
+    uint32_t size() const { return frozen_.keep ? frozen_.count : ids_.size(); }
+
+    std::string_view name(uint32_t id) const {
+        return frozen_.keep ? frozen_.name(id) : ids_.name(id);
+    }
+    long long total(uint32_t id) const { return cell(id).total; }
+
+    long long hourCount(uint32_t id, int hour) const {
+        const HourCell& c = cell(id);
+        if (c.used == kNarrowRow) return narrowRows()[(size_t)c.count[0] * kHours + hour];
+        if (c.used == kWideRow) return wideRows()[(size_t)c.count[0] * kHours + hour];
+        for (int i = 0; i < c.used; ++i) {
+            if (c.hour[i] == hour) return c.count[i];
+        }
+        return 0;
+    }
+
+    // visit(hour, count) for each of the zone's non-zero hours; inline
+    // pairs come in first-seen order, dense rows in hour order
+    template <class Visit>
+    void forEachHour(uint32_t id, Visit visit) const {
+        visitCell(cell(id), narrowRows(), wideRows(), visit);
+    }
+
+    // Non-zero (zone, hour) cells.
+    size_t busyCells() const { return frozen_.keep ? frozen_.busyCells : busyCells_; }
+
+    void memory(MemoryUsage& out) const {
+        out.zoneIndex += ids_.slotBytes();
+        out.zoneNames += ids_.nameBytes();
+        out.zoneCells += cells_.capacity() * sizeof(HourCell);
+        out.denseHours += narrow_.capacity() * sizeof(uint32_t) + wide_.capacity() * sizeof(long long);
+        if (frozen_.keep) {
+            size_t n = frozen_.count;
+            out.snapshot += n * sizeof(HourCell) + frozen_.narrowRows * kHours * sizeof(uint32_t) +
+                            frozen_.wideRows * kHours * sizeof(long long) + (n + 1) * sizeof(uint32_t) +
+                            (size_t)frozen_.nameOffsets[n];
+        }
+    }
+
+#ifdef TRIP_ANALYZER_STATS
+    // This table's counters, written by the ingest loops that fill it.
+    StatCounters& stats() { return stats_; }
+
+    void report(IngestStats& out) const {
+        out.enabled = true;
+        out.bytesRead = stats_.bytes;
+        out.rowsSeen = stats_.rows;
+        out.rowsAccepted = stats_.accepted;
+        out.rejectedFields = stats_.rejects[kRejectFields];
+        out.rejectedEmptyZone = stats_.rejects[kRejectEmptyZone];
+        out.rejectedBadTime = stats_.rejects[kRejectBadTime];
+        out.rejectedHourRange = stats_.rejects[kRejectHourRange];
+
+        // sampled phases are scaled up from the rows that were timed
+        double scale = stats_.sampledRows ? (double)stats_.rows / (double)stats_.sampledRows : 0.0;
+        out.readMs = (double)stats_.phaseNs[kPhaseRead] / 1e6;
+        out.tokenizeMs = (double)stats_.phaseNs[kPhaseTokenize] * scale / 1e6;
+        out.hourMs = (double)stats_.phaseNs[kPhaseHour] * scale / 1e6;
+        out.hashMs = (double)stats_.phaseNs[kPhaseHash] * scale / 1e6;
+        out.rehashMs = (double)stats_.phaseNs[kPhaseRehash] / 1e6;
+
+        out.zones = size();
+        out.loadFactor = ids_.capacity() ? (double)ids_.size() / (double)ids_.capacity() : 0.0;
+        out.rehashes = stats_.rehashes + ids_.rehashes();
+        out.frontCacheLookups = stats_.cacheLookups + front_.lookups();
+        out.frontCacheHits = stats_.cacheHits + front_.hits();
+        out.frontCacheHitRate = out.frontCacheLookups ? (double)out.frontCacheHits / (double)out.frontCacheLookups : 0.0;
+    }
+#endif
+
+private:
+    // Loading does not hash the names, so this is where a name repeated in
+    // a hand-made file is caught: it folds into its first id, like a merge.
+    // A file saveSnapshot wrote gets its ids back unchanged.
+    void thaw() {
+        if (!frozen_.keep) return;
+        FrozenTable f = std::move(frozen_);
+        frozen_ = FrozenTable();
+        ids_.reserve(f.count);
+        cells_.reserve(f.count);
+        for (uint32_t i = 0; i < f.count; ++i) {
+            uint32_t id = ids_.intern(f.name(i));
+            if (id == cells_.size()) cells_.push_back(HourCell());
+            cells_[id].total += f.cells[i].total;
+            visitCell(f.cells[i], f.narrow, f.wide, [&](int h, long long n) { addHours(id, h, n); });
+        }
+    }
+
+    const HourCell& cell(uint32_t id) const { return frozen_.keep ? frozen_.cells[id] : cells_[id]; }
+    const uint32_t* narrowRows() const { return frozen_.keep ? frozen_.narrow : narrow_.data(); }
+    const long long* wideRows() const { return frozen_.keep ? frozen_.wide : wide_.data(); }
+
+    template <class T, class Visit>
+    static void visitRow(const T* row, Visit& visit) {
+        for (int h = 0; h < kHours; ++h) {
+            if (row[h] != 0) visit(h, (long long)row[h]);
+        }
+    }
+
+    // A cell's non-zero hours, its dense row taken from `narrow` or `wide`.
+    // c is a copy: a self-merge may rewrite the cell while visiting it.
+    template <class Visit>
+    static void visitCell(HourCell c, const uint32_t* narrow, const long long* wide, Visit&& visit) {
+        if (c.used == kNarrowRow) {
+            visitRow(narrow + (size_t)c.count[0] * kHours, visit);
+        } else if (c.used == kWideRow) {
+            visitRow(wide + (size_t)c.count[0] * kHours, visit);
+        } else {
+            for (int i = 0; i < c.used; ++i) visit((int)c.hour[i], (long long)c.count[i]);
+        }
+    }
+
+    // add()'s slow path, and merging: n more trips in (id, hour), moving the
+    // zone to a dense or wider row first when they do not fit where it is
+    void addHours(uint32_t id, int hour, long long n) {
+        HourCell& c = cells_[id];
+        if (c.used <= kInlineHours) {
+            int i = 0;
+            while (i < c.used && c.hour[i] != hour) ++i;
+            bool found = i < c.used;
+            long long sum = (found ? (long long)c.count[i] : 0) + n;
+            if (sum <= (long long)UINT32_MAX && (found || c.used < kInlineHours)) {
+                if (!found) {
+                    c.hour[i] = (uint8_t)hour;
+                    c.used++;
+                    busyCells_++;
+                }
+                c.count[i] = (uint32_t)sum;
+                return;
+            }
+            toDense(c, sum > (long long)UINT32_MAX);
+        }
+        if (c.used == kNarrowRow) {
+            uint32_t& x = narrow_[(size_t)c.count[0] * kHours + hour];
+            if ((long long)x + n <= (long long)UINT32_MAX) {
+                busyCells_ += x == 0;
+                x = (uint32_t)(x + n);
+                return;
+            }
+            toWide(c);
+        }
+        long long& x = wide_[(size_t)c.count[0] * kHours + hour];
+        busyCells_ += x == 0;
+        x += n;
+    }
+
+    void toDense(HourCell& c, bool wide) {
+        HourCell pairs = c;
+        if (wide) {
+            c.count[0] = (uint32_t)(wide_.size() / kHours);
+            c.used = kWideRow;
+            wide_.resize(wide_.size() + kHours, 0);
+            for (int i = 0; i < pairs.used; ++i) wide_[(size_t)c.count[0] * kHours + pairs.hour[i]] = pairs.count[i];
+        } else {
+            c.count[0] = (uint32_t)(narrow_.size() / kHours);
+            c.used = kNarrowRow;
+            narrow_.resize(narrow_.size() + kHours, 0);
+            for (int i = 0; i < pairs.used; ++i) narrow_[(size_t)c.count[0] * kHours + pairs.hour[i]] = pairs.count[i];
+        }
+    }
+
+    // the 32-bit row is left behind unused; overflowing zones are rare
+    void toWide(HourCell& c) {
+        size_t from = (size_t)c.count[0] * kHours;
+        c.count[0] = (uint32_t)(wide_.size() / kHours);
+        c.used = kWideRow;
+        wide_.insert(wide_.end(), narrow_.begin() + (ptrdiff_t)from, narrow_.begin() + (ptrdiff_t)(from + kHours));
+    }
+
+    FrozenTable frozen_;
+    ZoneIndex ids_;
+    std::vector<HourCell> cells_;
+    std::vector<uint32_t> narrow_; // 24 counters per dense zone
+    std::vector<long long> wide_;  // 24 counters per zone that overflowed 32 bits
+    size_t busyCells_ = 0;
+    FrontCache front_;
+#ifdef TRIP_ANALYZER_STATS
+    StatCounters stats_;
+#endif
+};
+
+// Times the phases of one row in kStatSample; the rest pay a counter bump
+// and a branch. Without TRIP_ANALYZER_STATS it is an empty shell.
+class RowTimer {
+public:
+#ifdef TRIP_ANALYZER_STATS
+    explicit RowTimer(ZoneTable& zones) : stats_(zones.stats()) {
+        sampled_ = ++stats_.rows % kStatSample == 0;
+        if (sampled_) {
+            stats_.sampledRows++;
+            clock_ = statClockNs();
+            last_ = statNowNs();
+        }
+    }
+
+    // For a row the SIMD scanner split before handing it over: splitStart
+    // is when the scanner moved on to it (from nextSplitStart), and a
+    // sampled row charges the time since then to tokenize.
+    RowTimer(ZoneTable& zones, long long splitStart) : RowTimer(zones) {
+        if (sampled_ && splitStart) stats_.phaseNs[kPhaseTokenize] += std::max(0LL, last_ - splitStart - clock_);
+    }
+
+    // Now, if the next row on this table will be sampled; 0 otherwise.
+    static long long nextSplitStart(ZoneTable& zones) {
+        return (zones.stats().rows + 1) % kStatSample == 0 ? statNowNs() : 0;
+    }
+
+    // charge the time since the previous lap to `phase`
+    void lap(StatPhase phase) {
+        if (!sampled_) return;
+        long long now = statNowNs();
+        stats_.phaseNs[phase] += std::max(0LL, now - last_ - clock_);
+        last_ = now;
+    }
+
+private:
+    StatCounters& stats_;
+    bool sampled_;
+    long long clock_ = 0;
+    long long last_ = 0;
+#else
+    explicit RowTimer(ZoneTable&) {}
+    RowTimer(ZoneTable&, long long) {}
+    static long long nextSplitStart(ZoneTable&) { return 0; }
+    void lap(StatPhase) {}
+#endif
+};
 
 // ------------------- helpers -------------------
 
@@ -21,232 +578,1787 @@ static inline void stripCR(std::string& s) {
     if (!s.empty() && s.back() == '\r') s.pop_back();
 }
 
-static inline void trimInPlace(std::string& s) {
-    size_t b = 0;
-    while (b < s.size() && std::isspace((unsigned char)s[b])) ++b;
-    size_t e = s.size();
-    while (e > b && std::isspace((unsigned char)s[e - 1])) --e;
-    if (b == 0 && e == s.size()) return;
-    s.assign(s.begin() + (long)b, s.begin() + (long)e);
-}
-
 static inline void toUpperInPlace(std::string& s) {
     for (char& c : s) c = (char)std::toupper((unsigned char)c);
 }
 
-static std::vector<std::string> parseCSVLine(const std::string& line) {
-    std::vector<std::string> fields;
-    size_t i = 0;
-    std::string field;
-    bool inQuotes = false;
+// ------------------- ingest -------------------
 
-    while (i < line.size()) {
-        char ch = line[i];
+// Scratch reused across rows so the per-line work does not allocate.
+struct LineScratch {
+    CsvTokenizer fields;
+    std::string zone;
+};
 
-        if (!inQuotes && ch == ',') {
-            fields.push_back(field);
-            field.clear();
-            ++i;
-            continue;
+// case-insensitive "TripID" check on an already split first field
+static inline bool isHeaderField(std::string_view first) {
+    first = trimView(first);
+    static const char kTripId[] = "TRIPID";
+    if (first.size() != sizeof(kTripId) - 1) return false;
+    for (size_t i = 0; i < first.size(); ++i) {
+        if (std::toupper((unsigned char)first[i]) != kTripId[i]) return false;
+    }
+    return true;
+}
+
+static inline bool equalsNoCase(std::string_view a, std::string_view upper) {
+    if (a.size() != upper.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (std::toupper((unsigned char)a[i]) != (unsigned char)upper[i]) return false;
+    }
+    return true;
+}
+
+// Where the two columns we aggregate live, worked out once per file.
+// Without a usable header the 6-column SmallTrips layout is assumed.
+struct TripSchema {
+    size_t zoneCol = 1;
+    size_t timeCol = 3;
+    size_t minFields = 6; // rows with fewer fields are dirty
+
+    // fields a row must be split into before the rest can be skipped
+    size_t projected() const { return std::max(zoneCol, timeCol) + 1; }
+};
+
+// Map a header row onto a schema. False if it does not name both a pickup
+// zone and a pickup time column.
+static bool schemaFromHeader(const std::string_view* fields, size_t count, TripSchema& schema) {
+    size_t zoneCol = SIZE_MAX, timeCol = SIZE_MAX;
+    for (size_t i = 0; i < count; ++i) {
+        std::string_view name = trimView(fields[i]);
+        if (zoneCol == SIZE_MAX && (equalsNoCase(name, "PICKUPZONEID") || equalsNoCase(name, "PICKUPZONE"))) {
+            zoneCol = i;
+        } else if (timeCol == SIZE_MAX && (equalsNoCase(name, "PICKUPTIME") || equalsNoCase(name, "PICKUPDATETIME"))) {
+            timeCol = i;
         }
+    }
+    if (zoneCol == SIZE_MAX || timeCol == SIZE_MAX) return false;
 
-        if (ch == '"') {
-            if (!inQuotes) {
-                inQuotes = true;
-                ++i;
-                continue;
-            } else {
-                if (i + 1 < line.size() && line[i + 1] == '"') {
-                    field += '"';
-                    i += 2;
-                    continue;
-                } else {
-                    inQuotes = false;
-                    ++i;
-                    continue;
-                }
-            }
+    schema.zoneCol = zoneCol;
+    schema.timeCol = timeCol;
+    schema.minFields = count;
+    return true;
+}
+
+// Look at the first non-empty line of [p, end). A header (first field
+// "TripID", or one naming the pickup columns) is consumed and mapped;
+// otherwise p is left on that line and the default schema is used.
+static TripSchema detectSchema(const char*& p, const char* end, CsvTokenizer& tok) {
+    TripSchema schema;
+    while (p < end) {
+        const char* nl = (const char*)std::memchr(p, '\n', (size_t)(end - p));
+        const char* lineEnd = nl ? nl : end;
+
+        std::string_view line(p, (size_t)(lineEnd - p));
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        if (line.empty()) {
+            p = nl ? nl + 1 : end;
+            continue;
         }
 
-        field += ch;
-        ++i;
+        size_t count = tok.split(line);
+        bool named = schemaFromHeader(tok.data(), count, schema);
+        if (named || (count > 0 && isHeaderField(tok[0]))) p = nl ? nl + 1 : end;
+        return schema;
     }
+    return schema;
+}
 
-    if (!field.empty() || inQuotes) {
-        fields.push_back(field);
+// Trim, validate and count one (zone, time) pair.
+static void recordTrip(std::string_view zoneField, std::string_view timeField, LineScratch& s,
+                       ZoneTable& zones, RowTimer& timer) {
+    std::string_view pickupZone = trimView(zoneField);
+    std::string_view pickupDT = trimView(timeField);
+    if (pickupZone.empty()) {
+        TRIP_STAT(zones.stats().rejects[kRejectEmptyZone]++);
+        return;
     }
 
-    return fields;
+    int hour = -1;
+    HourParse parsed = parseHourFromDatetime(pickupDT, hour);
+    if (parsed != HourParse::Ok) {
+        TRIP_STAT(zones.stats().rejects[parsed == HourParse::OutOfRange ? kRejectHourRange : kRejectBadTime]++);
+        return;
+    }
+    timer.lap(kPhaseHour);
+
+    uint32_t id = zones.findRaw(pickupZone);
+    if (id == ZoneIndex::kNotFound) {
+        // case-insensitivity requirement: normalize zone ids
+        s.zone.assign(pickupZone.data(), pickupZone.size());
+        toUpperInPlace(s.zone);
+        id = zones.intern(s.zone);
+        zones.rememberRaw(pickupZone, id);
+    }
+    zones.add(id, hour);
+    timer.lap(kPhaseHash);
+    TRIP_STAT(zones.stats().accepted++);
 }
 
-// case-insensitive "TripID" header detection (after trimming)
-static inline bool isHeaderLine(const std::string& line) {
-    auto fields = parseCSVLine(line);
-    if (fields.empty()) return false;
+// One fully split row => at most one counted trip. splitStart is for the
+// tokenize timing, see RowTimer.
+static void ingestFields(const std::string_view* fields, size_t count, const TripSchema& schema,
+                         LineScratch& s, ZoneTable& zones, long long splitStart) {
+    RowTimer timer(zones, splitStart);
+    if (count < schema.minFields || count < schema.projected()) {
+        TRIP_STAT(zones.stats().rejects[kRejectFields]++);
+        return;
+    }
+    recordTrip(fields[schema.zoneCol], fields[schema.timeCol], s, zones, timer);
+}
 
-    std::string first = fields[0];
-    trimInPlace(first);
-    toUpperInPlace(first);
-    return (first == "TRIPID");
+// One line (no trailing '\n' or '\r') => at most one counted trip. Only the
+// columns up to the last one we read are split; the rest of the line is
+// just checked for the field count the schema asks for.
+static void ingestLine(std::string_view line, const TripSchema& schema, LineScratch& s,
+                       ZoneTable& zones) {
+    RowTimer timer(zones);
+    size_t need = schema.projected();
+    if (s.fields.split(line, need) < need ||
+        (schema.minFields > need && !s.fields.hasMoreFields(schema.minFields - need))) {
+        TRIP_STAT(zones.stats().rejects[kRejectFields]++);
+        return;
+    }
+    timer.lap(kPhaseTokenize);
+    recordTrip(s.fields[schema.zoneCol], s.fields[schema.timeCol], s, zones, timer);
 }
 
-// Parse hour from a datetime string robustly.
-// Accepts: "YYYY-MM-DD HH:MM", "YYYY-MM-DDTHH:MM", "YYYY-MM-DD HH:MM:SS", etc.
-// Strategy: find first ':' and extract the 1-2 digit hour immediately before it.
-static inline bool parseHourFromDatetime(std::string dt, int& hourOut) {
-    trimInPlace(dt);
-    if (dt.empty()) return false;
+#if TRIP_HAVE_MMAP
+// Read-only private mapping of a regular file; unmapped on destruction.
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() {
+        if (data_ != nullptr) ::munmap(data_, size_);
+    }
 
-    size_t colon = dt.find(':');
-    if (colon == std::string::npos) return false;
+    // false for pipes, devices and anything mmap refuses
+    bool open(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
 
-    size_t end = colon - 1;
-    if (end >= dt.size()) return false; // invalid
-    size_t start = end;
-    while (start > 0 && std::isdigit((unsigned char)dt[start - 1])) --start;
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+            ::close(fd);
+            return false;
+        }
 
-    std::string hStr = dt.substr(start, end - start + 1);
-    if (hStr.empty() || hStr.size() > 2) return false;
+        size_ = (size_t)st.st_size;
+        if (size_ > 0) {
+            void* p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED) {
+                ::close(fd);
+                return false;
+            }
+            data_ = p;
+            ::madvise(data_, size_, MADV_SEQUENTIAL);
+        }
+        ::close(fd);
+        return true;
+    }
+
+    const char* data() const { return (const char*)data_; }
+    size_t size() const { return size_; }
 
-    if (!std::all_of(hStr.begin(), hStr.end(), [](char c){ return std::isdigit((unsigned char)c); })) return false;
+private:
+    void* data_ = nullptr;
+    size_t size_ = 0;
+};
 
-    int h = std::stoi(hStr);
+// Drop the resident pages of [begin, end) of a mapping, widened to whole
+// pages. The bytes stay readable (from the page cache) but stop counting
+// against this process; the mapping is private and never written, so a
+// page another thread is still reading just faults back in.
+static void releasePages(const char* begin, const char* end) {
+    uintptr_t page = (uintptr_t)::sysconf(_SC_PAGESIZE);
+    uintptr_t from = (uintptr_t)begin / page * page;
+    uintptr_t to = (uintptr_t)end / page * page;
+    if (to > from) ::madvise((void*)from, to - from, MADV_DONTNEED);
+}
+#endif
 
-    std::string dtUpper = dt;
-    toUpperInPlace(dtUpper);
-    bool hasAm = dtUpper.find("AM") != std::string::npos;
-    bool hasPm = dtUpper.find("PM") != std::string::npos;
+// A pass over a mapped range gives back its pages every this many bytes.
+static const size_t kReleaseBytes = 16u << 20;
 
-    if (hasAm || hasPm) {
-        // 12-hour format
-        if (h < 1 || h > 12) return false;
-        if (hasPm) {
-            if (h != 12) h += 12;
-        } else { // AM
-            if (h == 12) h = 0;
+// Walk a byte range line by line, same splitting rules as std::getline.
+static void ingestBuffer(const char* p, const char* end, CsvEngine engine, const TripSchema& schema,
+                         LineScratch& s, ZoneTable& zones) {
+    if (engine == CsvEngine::Simd) {
+        CsvScanner scanner;
+        long long splitStart = RowTimer::nextSplitStart(zones);
+        scanner.scan(p, (size_t)(end - p), [&](const std::string_view* fields, size_t count) {
+            ingestFields(fields, count, schema, s, zones, splitStart);
+            splitStart = RowTimer::nextSplitStart(zones);
+        });
+        return;
+    }
+
+    while (p < end) {
+        const char* nl = (const char*)std::memchr(p, '\n', (size_t)(end - p));
+        const char* lineEnd = nl ? nl : end;
+
+        std::string_view line(p, (size_t)(lineEnd - p));
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        if (!line.empty()) ingestLine(line, schema, s, zones);
+
+        p = nl ? nl + 1 : end;
+    }
+}
+
+// A line-aligned range of a mapped file, kReleaseBytes at a time, so only
+// about that much of it is resident at once.
+static void ingestMappedRange(const char* p, const char* end, CsvEngine engine, const TripSchema& schema,
+                              LineScratch& s, ZoneTable& zones) {
+    while (p < end) {
+        const char* stop = end;
+        if ((size_t)(end - p) > kReleaseBytes) {
+            const char* nl = (const char*)std::memchr(p + kReleaseBytes, '\n', (size_t)(end - p) - kReleaseBytes);
+            if (nl != nullptr) stop = nl + 1;
         }
-    } else {
-        // 24-hour format
-        if (h < 0 || h > 23) return false;
+        ingestBuffer(p, stop, engine, schema, s, zones);
+#if TRIP_HAVE_MMAP
+        releasePages(p, stop);
+#endif
+        p = stop;
     }
+}
 
-    hourOut = h;
-    return true;
+// ------------------- parallel ingest -------------------
+
+// Below this many bytes per thread the split/merge costs more than it saves.
+static const size_t kMinChunkBytes = 1u << 20;
+
+static size_t resolveThreadCount(unsigned requested, size_t bytes) {
+    size_t n = requested;
+    if (n == 0) n = std::max(1u, std::thread::hardware_concurrency());
+    n = std::min(n, bytes / kMinChunkBytes);
+    return std::max<size_t>(n, 1);
 }
 
-// ------------------- TripAnalyzer implementation -------------------
+// Cut [0, size) into n ranges whose boundaries sit just past a '\n', so
+// every line belongs to exactly one range. Ranges may come out empty.
+static std::vector<size_t> splitAtLines(const char* data, size_t size, size_t n) {
+    std::vector<size_t> bounds(n + 1, size);
+    bounds[0] = 0;
+    for (size_t i = 1; i < n; ++i) {
+        size_t pos = std::max(bounds[i - 1], size / n * i);
+        const char* nl = pos < size ? (const char*)std::memchr(data + pos, '\n', size - pos) : nullptr;
+        bounds[i] = nl ? (size_t)(nl - data) + 1 : size;
+    }
+    return bounds;
+}
 
-void TripAnalyzer::ingestFile(const std::string& csvPath) {
-    auto& zoneTrips = g_zoneTrips[this];
-    auto& zoneHour  = g_zoneHourTrips[this];
+// Each worker aggregates its own range into private tables; the tables are
+// folded together in range order once every worker is done. Counts are plain
+// sums, so the result is the same as the serial pass.
+static void ingestChunked(const char* data, size_t size, size_t nThreads, CsvEngine engine,
+                          const TripSchema& schema, ZoneTable& zones) {
+    std::vector<size_t> bounds = splitAtLines(data, size, nThreads);
+    std::vector<ZoneTable> parts(nThreads); // thread-local partials, one per range
+    std::vector<std::exception_ptr> errors(nThreads);
+    std::vector<std::thread> workers;
+    workers.reserve(nThreads - 1);
+
+    auto work = [&](size_t i) {
+        try {
+            LineScratch s;
+            ingestMappedRange(data + bounds[i], data + bounds[i + 1], engine, schema, s, parts[i]);
+        } catch (...) {
+            errors[i] = std::current_exception();
+        }
+    };
 
-    zoneTrips.clear();
-    zoneHour.clear();
+    for (size_t i = 1; i < nThreads; ++i) workers.emplace_back(work, i);
+    work(0);
+    for (auto& t : workers) t.join();
+
+    for (const auto& e : errors) {
+        if (e) std::rethrow_exception(e);
+    }
+    for (auto& part : parts) {
+        zones.merge(part);
+        part = ZoneTable{}; // release memory as soon as it is folded in
+    }
+}
 
+// false => the file could not be mapped and the caller should stream it
+static bool ingestMapped(const std::string& csvPath, const IngestOptions& opts,
+                         ZoneTable& zones) {
+#if TRIP_HAVE_MMAP
+    MappedFile file;
+    if (!file.open(csvPath)) return false;
+    TRIP_STAT(zones.stats().bytes += (long long)file.size());
+
+    const char* p = file.data();
+    const char* end = p + file.size();
+    LineScratch s;
+    TripSchema schema = detectSchema(p, end, s.fields);
+
+    size_t nThreads = resolveThreadCount(opts.threads, (size_t)(end - p));
+    if (nThreads > 1) {
+        ingestChunked(p, (size_t)(end - p), nThreads, opts.engine, schema, zones);
+        return true;
+    }
+    ingestMappedRange(p, end, opts.engine, schema, s, zones);
+    return true;
+#else
+    (void)csvPath; (void)opts; (void)zones;
+    return false;
+#endif
+}
+
+// getline reader for pipes, unmappable files and useMmap = false.
+static void ingestGetline(const std::string& csvPath, ZoneTable& zones) {
     std::ifstream in(csvPath);
     if (!in.is_open()) {
         // Requirement: never crash; missing file => empty result
         return;
     }
 
+    LineScratch scratch;
+    TripSchema schema;
+    bool sawFirstLine = false;
     std::string line;
     while (std::getline(in, line)) {
+        TRIP_STAT(zones.stats().bytes += (long long)line.size() + 1);
         stripCR(line);
         if (line.empty()) continue;
 
-        // skip header (case-insensitive)
-        if (isHeaderLine(line)) continue;
+        if (!sawFirstLine) {
+            sawFirstLine = true;
+            const char* p = line.data();
+            schema = detectSchema(p, p + line.size(), scratch.fields);
+            if (p != line.data()) continue; // header consumed
+        }
+        ingestLine(line, schema, scratch, zones);
+    }
+}
+
+// Feeds a file that arrives in pieces, each ending on a line boundary,
+// through ingestBuffer. The first non-empty line of the whole file is
+// checked for a header, exactly as the other readers do.
+struct PieceReader {
+    bool sawFirstLine = false;
+    TripSchema schema;
+    LineScratch scratch;
+
+    void feed(const char* p, const char* end, CsvEngine engine, ZoneTable& zones) {
+        while (!sawFirstLine && p < end) {
+            const char* nl = (const char*)std::memchr(p, '\n', (size_t)(end - p));
+            const char* lineEnd = nl ? nl : end;
+            if (lineEnd > p && lineEnd[-1] == '\r') --lineEnd;
+            if (lineEnd == p) {
+                p = nl ? nl + 1 : end; // empty line
+                continue;
+            }
+            sawFirstLine = true;
+            schema = detectSchema(p, end, scratch.fields);
+        }
+        if (p < end) ingestBuffer(p, end, engine, schema, scratch, zones);
+    }
+
+    void reset() {
+        sawFirstLine = false;
+        schema = TripSchema();
+    }
 
-        auto fields = parseCSVLine(line);
-        if (fields.size() < 6) continue;
+    // for a range of a file whose header was already read
+    void resume(const TripSchema& fileSchema) {
+        sawFirstLine = true;
+        schema = fileSchema;
+    }
+};
 
-        std::string pickupZone = fields[1];
-        std::string pickupDT = fields[3];
+// Cuts arbitrary blocks of a file into whole-line pieces for PieceReader.
+// A line cut by a block edge is carried over and finished with the start
+// of the next block.
+struct BlockLines {
+    PieceReader pieces;
+    std::string carry;
+    CsvEngine engine = CsvEngine::Lines;
 
-        trimInPlace(pickupZone);
-        if (pickupZone.empty()) continue;
+    void feed(const char* begin, const char* end, ZoneTable& zones) {
+        const char* first = (const char*)std::memchr(begin, '\n', (size_t)(end - begin));
+        if (first == nullptr) {
+            carry.append(begin, end);
+            return;
+        }
+        const char* last = end;
+        while (last[-1] != '\n') --last;
+        if (!carry.empty()) {
+            carry.append(begin, first + 1);
+            pieces.feed(carry.data(), carry.data() + carry.size(), engine, zones);
+            carry.clear();
+            begin = first + 1;
+        }
+        pieces.feed(begin, last, engine, zones);
+        carry.assign(last, end);
+    }
 
-        // case-insensitivity requirement: normalize zone ids
-        toUpperInPlace(pickupZone);
+    // a last line without '\n' still counts, as with getline
+    void finish(ZoneTable& zones) {
+        if (!carry.empty()) pieces.feed(carry.data(), carry.data() + carry.size(), engine, zones);
+        carry.clear();
+    }
+};
 
-        trimInPlace(pickupDT);
-        int hour = -1;
-        if (!parseHourFromDatetime(pickupDT, hour)) continue;
+// Run one read call (returning a byte count), charging its time and bytes
+// to the table's stats.
+template <class Read>
+static auto timedRead(ZoneTable& zones, Read read) -> decltype(read()) {
+#ifdef TRIP_ANALYZER_STATS
+    long long start = statNowNs();
+    auto n = read();
+    zones.stats().phaseNs[kPhaseRead] += statNowNs() - start;
+    if (n > 0) zones.stats().bytes += (long long)n;
+    return n;
+#else
+    (void)zones;
+    return read();
+#endif
+}
+
+// Default size of the stream and descriptor readers' blocks.
+static const size_t kReadBlockBytes = 4u << 20;
+
+static size_t readBlockBytes(const IngestOptions& opts) {
+    return opts.readBlockBytes ? opts.readBlockBytes : kReadBlockBytes;
+}
+
+// Plain blocking reads of a whole stream.
+static void ingestIstream(std::istream& in, CsvEngine engine, size_t blockBytes, ZoneTable& zones) {
+    std::vector<char> buf(blockBytes);
+    BlockLines lines;
+    lines.engine = engine;
+    while (in) {
+        std::streamsize n = timedRead(zones, [&] {
+            in.read(buf.data(), (std::streamsize)buf.size());
+            return in.gcount();
+        });
+        if (n <= 0) break;
+        lines.feed(buf.data(), buf.data() + n, zones);
+    }
+    lines.finish(zones);
+}
+
+// ------------------- pipelined reader -------------------
+
+#if TRIP_HAVE_MMAP
+// What a descriptor reader reads. By default, the rest of the file through
+// read(2). A range [pos, end) of a regular file is read through pread(2),
+// which leaves the file offset alone so several ranges of one descriptor
+// can be read at once; its lines are parsed with the schema of the file.
+struct ReadSpan {
+    off_t pos = -1; // -1: read to end of file
+    off_t end = 0;
+    const TripSchema* schema = nullptr;
+
+    ssize_t read(int fd, char* buf, size_t n) {
+        if (pos < 0) return ::read(fd, buf, n);
+        if (pos >= end) return 0;
+        ssize_t got = ::pread(fd, buf, std::min(n, (size_t)(end - pos)), pos);
+        if (got > 0) pos += got;
+        return got;
+    }
+};
+
+// Single-producer/single-consumer ring of small values (buffer indexes).
+// Each side only writes its own index, so a handoff is one release store.
+template <size_t N>
+class SpscRing {
+public:
+    bool push(size_t v) {
+        size_t t = tail_.load(std::memory_order_relaxed);
+        if (t - head_.load(std::memory_order_acquire) == N) return false;
+        slots_[t % N] = v;
+        tail_.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(size_t& v) {
+        size_t h = head_.load(std::memory_order_relaxed);
+        if (h == tail_.load(std::memory_order_acquire)) return false;
+        v = slots_[h % N];
+        head_.store(h + 1, std::memory_order_release);
+        return true;
+    }
 
-        // Update totals
-        zoneTrips[pickupZone]++;
+private:
+    size_t slots_[N];
+    alignas(64) std::atomic<size_t> head_{0};
+    alignas(64) std::atomic<size_t> tail_{0};
+};
 
-        auto it = zoneHour.find(pickupZone);
-        if (it == zoneHour.end()) {
-            std::array<long long, 24> arr{};
-            arr.fill(0);
-            arr[hour] = 1;
-            zoneHour.emplace(pickupZone, arr);
+// Spin briefly, then yield, then sleep: a waiting side costs little CPU
+// but still picks up a handoff quickly.
+template <class Ready>
+static bool waitFor(Ready ready, const std::atomic<bool>& stop) {
+    for (unsigned spins = 0; !ready(); ++spins) {
+        if (stop.load(std::memory_order_relaxed)) return false;
+        if (spins < 64) continue;
+        if (spins < 256) std::this_thread::yield();
+        else std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+    return true;
+}
+
+// Reads fd on a helper thread into a few large page-aligned buffers while
+// this thread parses the previous one. Full buffers go to the parser through
+// one ring and come back empty through another.
+static void ingestDescriptorAsync(int fd, CsvEngine engine, size_t blockBytes, ZoneTable& zones,
+                                  ReadSpan span = ReadSpan()) {
+    const size_t kBuffers = 4;
+    const size_t kBufBytes = blockBytes;
+
+    struct AlignedFree {
+        void operator()(char* p) const { std::free(p); }
+    };
+    std::vector<std::unique_ptr<char, AlignedFree>> bufs;
+    for (size_t i = 0; i < kBuffers; ++i) {
+        void* p = nullptr;
+        if (::posix_memalign(&p, 4096, kBufBytes) != 0) throw std::bad_alloc();
+        bufs.emplace_back((char*)p);
+    }
+    std::vector<size_t> lens(kBuffers, 0);
+    SpscRing<kBuffers> full, empty;
+    for (size_t i = 0; i < kBuffers; ++i) empty.push(i);
+    std::atomic<bool> stop{false};
+#ifdef TRIP_ANALYZER_STATS
+    long long readNs = 0; // the reader's own, added to the stats after join
+#endif
+
+    // fills one buffer per handoff; a zero length marks end of input
+    std::thread reader([&] {
+        for (;;) {
+            size_t idx = 0;
+            if (!waitFor([&] { return empty.pop(idx); }, stop)) return;
+#ifdef TRIP_ANALYZER_STATS
+            long long start = statNowNs();
+#endif
+            size_t len = 0;
+            while (len < kBufBytes) {
+                ssize_t n = span.read(fd, bufs[idx].get() + len, kBufBytes - len);
+                if (n < 0 && errno == EINTR) continue;
+                if (n <= 0) break;
+                len += (size_t)n;
+            }
+            TRIP_STAT(readNs += statNowNs() - start);
+            lens[idx] = len;
+            full.push(idx); // never full: only kBuffers indexes exist
+            if (len == 0) return;
+        }
+    });
+
+    try {
+        BlockLines lines;
+        lines.engine = engine;
+        if (span.schema) lines.pieces.resume(*span.schema);
+        for (;;) {
+            size_t idx = 0;
+            waitFor([&] { return full.pop(idx); }, stop);
+            if (lens[idx] == 0) break;
+            TRIP_STAT(zones.stats().bytes += (long long)lens[idx]);
+            lines.feed(bufs[idx].get(), bufs[idx].get() + lens[idx], zones);
+            empty.push(idx);
+        }
+        lines.finish(zones);
+    } catch (...) {
+        stop = true;
+        reader.join();
+        throw;
+    }
+    reader.join();
+    TRIP_STAT(zones.stats().phaseNs[kPhaseRead] += readNs);
+}
+
+// Blocking reads straight into one buffer; no getline, no istream.
+static void ingestDescriptor(int fd, CsvEngine engine, size_t blockBytes, ZoneTable& zones,
+                             ReadSpan span = ReadSpan()) {
+    std::vector<char> buf(blockBytes);
+    BlockLines lines;
+    lines.engine = engine;
+    if (span.schema) lines.pieces.resume(*span.schema);
+    for (;;) {
+        ssize_t n = timedRead(zones, [&] { return span.read(fd, buf.data(), buf.size()); });
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        lines.feed(buf.data(), buf.data() + n, zones);
+    }
+    lines.finish(zones);
+}
+
+// false => the file could not be opened
+static bool ingestPipelined(const std::string& csvPath, CsvEngine engine, size_t blockBytes, ZoneTable& zones) {
+    int fd = ::open(csvPath.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    try {
+        ingestDescriptorAsync(fd, engine, blockBytes, zones);
+    } catch (...) {
+        ::close(fd);
+        throw;
+    }
+    ::close(fd);
+    return true;
+}
+#endif
+
+// ------------------- multi-file ingest -------------------
+
+// Replace glob patterns with their matches (sorted, as glob(3) returns
+// them); plain paths pass through untouched. A path that exists as written
+// is plain even if it holds '*', '?' or '[', so "trips[1].csv" is that file.
+static std::vector<std::string> expandPaths(const std::vector<std::string>& patterns) {
+    std::vector<std::string> paths;
+    for (const auto& pattern : patterns) {
+#if TRIP_HAVE_MMAP
+        struct stat st;
+        if (pattern.find_first_of("*?[") != std::string::npos && ::stat(pattern.c_str(), &st) != 0) {
+            glob_t g;
+            if (::glob(pattern.c_str(), 0, nullptr, &g) == 0) {
+                for (size_t i = 0; i < g.gl_pathc; ++i) paths.emplace_back(g.gl_pathv[i]);
+            }
+            ::globfree(&g);
+            continue;
+        }
+#endif
+        paths.push_back(pattern);
+    }
+    return paths;
+}
+
+// Runs a fixed set of task indexes on n threads. Worker w starts with a
+// contiguous block of the indexes and takes its own from the front; once
+// it runs dry it steals from the back of the others' blocks, so one slow
+// block does not leave the remaining cores idle.
+class StealingPool {
+public:
+    StealingPool(size_t nTasks, size_t nWorkers) : queues_(nWorkers) {
+        for (size_t i = 0; i < nTasks; ++i) queues_[i * nWorkers / nTasks].tasks.push_back(i);
+    }
+    ~StealingPool() { join(); }
+
+    // `task(i)` must not throw.
+    template <class Task>
+    void start(Task task) {
+        for (size_t w = 0; w < queues_.size(); ++w) {
+            workers_.emplace_back([this, w, task] {
+                size_t i;
+                while (next(w, i)) task(i);
+            });
+        }
+    }
+
+    void join() {
+        for (auto& t : workers_) t.join();
+        workers_.clear();
+    }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<size_t> tasks;
+    };
+
+    bool next(size_t w, size_t& task) {
+        for (size_t d = 0; d < queues_.size(); ++d) {
+            Queue& q = queues_[(w + d) % queues_.size()];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            if (q.tasks.empty()) continue;
+            if (d == 0) {
+                task = q.tasks.front();
+                q.tasks.pop_front();
+            } else {
+                task = q.tasks.back();
+                q.tasks.pop_back();
+            }
+            return true;
+        }
+        return false;
+    }
+
+    std::vector<Queue> queues_;
+    std::vector<std::thread> workers_;
+};
+
+#if TRIP_HAVE_MMAP
+// Reads up to n bytes at pos; short only at end of file.
+static size_t preadFull(int fd, char* buf, size_t n, off_t pos) {
+    size_t got = 0;
+    while (got < n) {
+        ssize_t r = ::pread(fd, buf + got, n - got, pos + (off_t)got);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) break;
+        got += (size_t)r;
+    }
+    return got;
+}
+
+// The offset just past the first '\n' at or after pos, or size if none.
+static off_t nextLineAt(int fd, off_t pos, off_t size) {
+    char buf[16 << 10];
+    while (pos < size) {
+        size_t n = preadFull(fd, buf, std::min(sizeof(buf), (size_t)(size - pos)), pos);
+        if (n == 0) break;
+        const char* nl = (const char*)std::memchr(buf, '\n', n);
+        if (nl) return pos + (off_t)(nl - buf) + 1;
+        pos += (off_t)n;
+    }
+    return size;
+}
+
+// detectSchema for a file that is read rather than mapped: returns the
+// offset of the first line after the header (0 if there is none).
+static off_t detectSchemaAt(int fd, off_t size, TripSchema& schema) {
+    std::string line;
+    CsvTokenizer tok;
+    for (off_t pos = 0; pos < size;) {
+        off_t next = nextLineAt(fd, pos, size);
+        line.resize((size_t)(next - pos));
+        line.resize(preadFull(fd, &line[0], line.size(), pos));
+        std::string_view text(line);
+        if (!text.empty() && text.back() == '\n') text.remove_suffix(1);
+        if (!text.empty() && text.back() == '\r') text.remove_suffix(1);
+        if (text.empty()) {
+            pos = next; // empty line
+            continue;
+        }
+        const char* p = line.data();
+        schema = detectSchema(p, p + line.size(), tok);
+        return p == line.data() ? pos : next; // data, or past the header
+    }
+    return size;
+}
+
+// splitAtLines for [begin, size) of a file that is read rather than mapped.
+static std::vector<off_t> splitFileAtLines(int fd, off_t begin, off_t size, size_t n) {
+    std::vector<off_t> bounds(n + 1, size);
+    bounds[0] = begin;
+    for (size_t i = 1; i < n; ++i) {
+        off_t pos = std::max(bounds[i - 1], begin + (size - begin) / (off_t)n * (off_t)i);
+        bounds[i] = nextLineAt(fd, pos, size);
+    }
+    return bounds;
+}
+#endif
+
+// One unit of multi-file work: a line-aligned range of a mapped file, a
+// byte range of a file read through the block reader, or a whole file
+// that has to be streamed.
+struct FileTask {
+    const char* begin = nullptr;
+    const char* end = nullptr;
+    const TripSchema* schema = nullptr;
+#if TRIP_HAVE_MMAP
+    int fd = -1; // read with span rather than mapped
+    ReadSpan span;
+#endif
+    const std::string* streamPath = nullptr;
+};
+
+// Every file is mapped up front (or, with useMmap off or for a file mmap
+// refuses, opened and read with pread) and cut into ranges of about a
+// quarter of a worker's share of the total bytes, so a huge file spreads
+// over all workers while small ones stay whole. Pipes and other files with
+// no size are read whole. Each task fills a private table; the caller
+// folds the tables in file and range order as they complete, which gives
+// the same table as ingesting the files one after another.
+static void ingestMany(const std::vector<std::string>& paths, const IngestOptions& opts,
+                       ZoneTable& zones) {
+    size_t nWorkers = opts.threads ? opts.threads : std::max(1u, std::thread::hardware_concurrency());
+
+    struct Source {
+#if TRIP_HAVE_MMAP
+        MappedFile file;
+        int fd = -1;       // open when not mapped
+        off_t size = -1;   // -1: not a regular file, read whole
+        off_t bodyAt = 0;  // first byte after the header
+        ~Source() {
+            if (fd >= 0) ::close(fd);
+        }
+#endif
+        bool mapped = false;
+        const char* begin = nullptr;
+        TripSchema schema;
+    };
+    std::vector<std::unique_ptr<Source>> sources;
+    size_t totalBytes = 0;
+    for (const auto& path : paths) {
+        auto src = std::make_unique<Source>();
+#if TRIP_HAVE_MMAP
+        if (opts.useMmap && src->file.open(path)) {
+            src->mapped = true;
+            const char* end = src->file.data() + src->file.size();
+            src->begin = src->file.data();
+            CsvTokenizer tok;
+            src->schema = detectSchema(src->begin, end, tok);
+            totalBytes += (size_t)(end - src->begin);
+            TRIP_STAT(zones.stats().bytes += (long long)src->file.size());
+        } else if ((src->fd = ::open(path.c_str(), O_RDONLY)) >= 0) {
+            struct stat st;
+            if (::fstat(src->fd, &st) == 0 && S_ISREG(st.st_mode)) {
+                src->size = st.st_size;
+                src->bodyAt = detectSchemaAt(src->fd, src->size, src->schema);
+                totalBytes += (size_t)(src->size - src->bodyAt);
+                TRIP_STAT(zones.stats().bytes += (long long)src->bodyAt); // the readers count the rest
+            }
+        }
+#endif
+        sources.push_back(std::move(src));
+    }
+
+    size_t target = std::max(kMinChunkBytes, totalBytes / (nWorkers * 4));
+    std::vector<FileTask> tasks;
+    for (size_t f = 0; f < paths.size(); ++f) {
+        const Source& src = *sources[f];
+        FileTask task;
+#if TRIP_HAVE_MMAP
+        if (!src.mapped && src.fd >= 0) {
+            task.fd = src.fd;
+            if (src.size < 0) {
+                tasks.push_back(task); // a pipe or device: one pass to its end
+                continue;
+            }
+            off_t size = src.size - src.bodyAt;
+            std::vector<off_t> bounds =
+                splitFileAtLines(src.fd, src.bodyAt, src.size, std::max<size_t>(1, (size_t)size / target));
+            for (size_t i = 0; i + 1 < bounds.size(); ++i) {
+                if (bounds[i] == bounds[i + 1]) continue;
+                task.span.pos = bounds[i];
+                task.span.end = bounds[i + 1];
+                task.span.schema = &src.schema;
+                tasks.push_back(task);
+            }
+            continue;
+        }
+#endif
+        if (!src.mapped) {
+            task.streamPath = &paths[f];
+            tasks.push_back(task);
+            continue;
+        }
+#if TRIP_HAVE_MMAP
+        size_t size = (size_t)(src.file.data() + src.file.size() - src.begin);
+        std::vector<size_t> bounds = splitAtLines(src.begin, size, std::max<size_t>(1, size / target));
+        for (size_t i = 0; i + 1 < bounds.size(); ++i) {
+            if (bounds[i] == bounds[i + 1]) continue;
+            task.begin = src.begin + bounds[i];
+            task.end = src.begin + bounds[i + 1];
+            task.schema = &src.schema;
+            tasks.push_back(task);
+        }
+#endif
+    }
+    if (tasks.empty()) return;
+
+    std::vector<ZoneTable> parts(tasks.size());
+    std::vector<std::exception_ptr> errors(tasks.size());
+    std::vector<char> done(tasks.size(), 0);
+    std::mutex doneMutex;
+    std::condition_variable doneCv;
+    std::atomic<bool> failed{false};
+
+    StealingPool pool(tasks.size(), std::min(nWorkers, tasks.size()));
+    pool.start([&](size_t i) {
+        try {
+            const FileTask& t = tasks[i];
+            if (failed) {
+                // an earlier failure ends the ingest; just drain the queue
+#if TRIP_HAVE_MMAP
+            } else if (t.fd >= 0) {
+                size_t blockBytes = readBlockBytes(opts);
+                if (opts.asyncRead) ingestDescriptorAsync(t.fd, opts.engine, blockBytes, parts[i], t.span);
+                else ingestDescriptor(t.fd, opts.engine, blockBytes, parts[i], t.span);
+#endif
+            } else if (t.streamPath) {
+                ingestGetline(*t.streamPath, parts[i]);
+            } else {
+                LineScratch s;
+                ingestMappedRange(t.begin, t.end, opts.engine, *t.schema, s, parts[i]);
+            }
+        } catch (...) {
+            errors[i] = std::current_exception();
+            failed = true;
+        }
+        {
+            std::lock_guard<std::mutex> lock(doneMutex);
+            done[i] = 1;
+        }
+        doneCv.notify_all();
+    });
+
+    for (size_t i = 0; i < tasks.size(); ++i) {
+        {
+            std::unique_lock<std::mutex> lock(doneMutex);
+            doneCv.wait(lock, [&] { return done[i] != 0; });
+        }
+        if (errors[i]) {
+            pool.join();
+            std::rethrow_exception(errors[i]);
+        }
+        zones.merge(parts[i]);
+        parts[i] = ZoneTable{}; // release memory as soon as it is folded in
+    }
+}
+
+// ------------------- snapshot -------------------
+//
+// File layout, native byte order, every section 8-byte aligned so the
+// arrays can be used in place from a mapping:
+//   SnapshotHeader
+//   HourCell cells[zoneCount]           (24 bytes: total, inline pairs or a row index)
+//   uint32   narrow[narrowRows * 24]    (rows of the kNarrowRow cells, in zone order)
+//   int64    wide[wideRows * 24]        (rows of the kWideRow cells, in zone order)
+//   uint32   nameOffsets[zoneCount + 1] (offsets into the name blob, zero padded)
+//   char     names[nameBytes]           (zero padded to a multiple of 8)
+// As in memory, a sparse zone takes a cell and nothing else. The checksum
+// covers everything after the header, so a truncated or damaged file is
+// rejected before any of it is used.
+
+static const uint32_t kSnapshotVersion = 2;
+static const uint32_t kSnapshotByteOrder = 0x01020304;
+
+struct SnapshotHeader {
+    char magic[8]; // "TRIPSNAP"
+    uint32_t version;
+    uint32_t byteOrder; // kSnapshotByteOrder as the writer saw it
+    uint64_t zoneCount;
+    uint64_t nameBytes;
+    uint64_t payloadBytes; // everything after the header
+    uint64_t checksum;
+    uint64_t narrowRows;
+    uint64_t wideRows;
+};
+static_assert(sizeof(SnapshotHeader) == 64, "snapshot header must stay 64 bytes");
+
+// One multiply per 8-byte word, so verifying runs at close to memory speed.
+static uint64_t snapshotChecksum(const char* p, size_t nWords) {
+    uint64_t h = 0xCBF29CE484222325ull;
+    for (size_t i = 0; i < nWords; ++i) {
+        uint64_t w;
+        std::memcpy(&w, p + i * 8, 8);
+        h = (h ^ w) * 0x100000001B3ull;
+        h ^= h >> 29;
+    }
+    return h;
+}
+
+// 8-byte words before the name offsets, and in the whole payload
+static size_t cellWords(const SnapshotHeader& h) {
+    return (size_t)(h.zoneCount * sizeof(HourCell) / 8 + h.narrowRows * ZoneTable::kHours / 2 +
+                    h.wideRows * ZoneTable::kHours);
+}
+
+static size_t payloadWords(const SnapshotHeader& h) {
+    return cellWords(h) + (size_t)(((h.zoneCount + 1) * 4 + 7) / 8 + (h.nameBytes + 7) / 8);
+}
+
+// The checksum only catches accidents, so the counts are checked as well:
+// a cell holds inline pairs for distinct hours with non-zero counts, or
+// the next unused row of its width; no count is negative; every total is
+// the sum of its hours. Counts the non-zero cells for busyCells() on the way.
+template <class T>
+static bool sumRow(const T* row, long long& sum, size_t& busy) {
+    for (int h = 0; h < ZoneTable::kHours; ++h) {
+        long long n = (long long)row[h];
+        if (n < 0 || n > LLONG_MAX - sum) return false;
+        sum += n;
+        busy += n != 0;
+    }
+    return true;
+}
+
+static bool checkCells(FrozenTable& t) {
+    size_t nextNarrow = 0, nextWide = 0, busy = 0;
+    for (uint32_t id = 0; id < t.count; ++id) {
+        const HourCell& c = t.cells[id];
+        long long sum = 0;
+        if (c.used == kNarrowRow) {
+            if (nextNarrow == t.narrowRows || c.count[0] != nextNarrow) return false;
+            if (!sumRow(t.narrow + nextNarrow++ * ZoneTable::kHours, sum, busy)) return false;
+        } else if (c.used == kWideRow) {
+            if (nextWide == t.wideRows || c.count[0] != nextWide) return false;
+            if (!sumRow(t.wide + nextWide++ * ZoneTable::kHours, sum, busy)) return false;
+        } else if (c.used <= kInlineHours) {
+            uint32_t seen = 0;
+            for (int i = 0; i < c.used; ++i) {
+                if (c.hour[i] >= ZoneTable::kHours || c.count[i] == 0 || (seen >> c.hour[i] & 1)) return false;
+                seen |= 1u << c.hour[i];
+                sum += c.count[i];
+            }
+            busy += c.used;
         } else {
-            it->second[hour]++;
+            return false;
         }
+        if (c.total != sum) return false;
     }
+    t.busyCells = busy;
+    return nextNarrow == t.narrowRows && nextWide == t.wideRows;
 }
 
-std::vector<ZoneCount> TripAnalyzer::topZones(int k) const {
-    if (k <= 0) return {};
+#if TRIP_HAVE_MMAP
+// write(2) all of [p, p + n), through short writes and EINTR.
+static bool writeAll(int fd, const char* p, size_t n) {
+    while (n > 0) {
+        ssize_t w = ::write(fd, p, n);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) return false;
+        p += w;
+        n -= (size_t)w;
+    }
+    return true;
+}
+
+// fsync the directory `path` is in, so a rename into it survives a crash.
+// Filesystems that cannot sync a directory (EINVAL) have nothing to flush.
+static bool syncParentDir(const std::string& path) {
+    size_t slash = path.find_last_of('/');
+    std::string dir = slash == std::string::npos ? "." : path.substr(0, slash == 0 ? 1 : slash);
+    int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) return false;
+    bool ok = ::fsync(fd) == 0 || errno == EINVAL;
+    ::close(fd);
+    return ok;
+}
 
-    auto itObj = g_zoneTrips.find(this);
-    if (itObj == g_zoneTrips.end()) return {};
+// The temporary file is on disk before it is renamed over `path`.
+static bool writeDurably(const std::string& tmp, const SnapshotHeader& h, const std::vector<char>& payload) {
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+    bool ok = writeAll(fd, (const char*)&h, sizeof(h)) && writeAll(fd, payload.data(), payload.size()) &&
+              ::fsync(fd) == 0;
+    if (::close(fd) != 0) ok = false;
+    return ok;
+}
+#else
+static bool writeDurably(const std::string& tmp, const SnapshotHeader& h, const std::vector<char>& payload) {
+    std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) return false;
+    out.write((const char*)&h, sizeof(h));
+    out.write(payload.data(), (std::streamsize)payload.size());
+    return (bool)out.flush();
+}
+#endif
 
-    const auto& zoneTrips = itObj->second;
+// Written to a temporary file, synced, and renamed over `path`, so a reader
+// never sees a half-written snapshot and a crash leaves the old file or
+// the complete new one.
+static bool writeSnapshot(const ZoneTable& zones, const std::string& path) {
+    const int kHours = ZoneTable::kHours;
+    uint64_t n = zones.size();
+    uint64_t nameBytes = 0;
+    for (uint32_t id = 0; id < n; ++id) nameBytes += zones.name(id).size();
+    if (nameBytes > UINT32_MAX) return false;
 
-    std::vector<ZoneCount> v;
-    v.reserve(zoneTrips.size());
-    for (const auto& kv : zoneTrips) {
-        v.push_back({kv.first, kv.second});
+    // a zone that fits in inline pairs keeps them; any other gets a row,
+    // 32-bit unless a count needs more
+    std::vector<HourCell> cells(n);
+    std::vector<uint32_t> narrow;
+    std::vector<long long> wide;
+    for (uint32_t id = 0; id < n; ++id) {
+        HourCell& c = cells[id];
+        c.total = zones.total(id);
+        long long row[ZoneTable::kHours] = {};
+        int used = 0;
+        bool fits = true;
+        zones.forEachHour(id, [&](int h, long long count) {
+            if (used < kInlineHours) {
+                c.hour[used] = (uint8_t)h;
+                c.count[used] = (uint32_t)count;
+            }
+            row[h] = count;
+            used++;
+            fits = fits && count <= (long long)UINT32_MAX;
+        });
+        if (used <= kInlineHours && fits) {
+            c.used = (uint8_t)used;
+            continue;
+        }
+        c = HourCell();
+        c.total = zones.total(id);
+        if (fits) {
+            c.used = kNarrowRow;
+            c.count[0] = (uint32_t)(narrow.size() / kHours);
+            for (long long x : row) narrow.push_back((uint32_t)x);
+        } else {
+            c.used = kWideRow;
+            c.count[0] = (uint32_t)(wide.size() / kHours);
+            wide.insert(wide.end(), row, row + kHours);
+        }
+    }
+
+    SnapshotHeader h{};
+    std::memcpy(h.magic, "TRIPSNAP", 8);
+    h.version = kSnapshotVersion;
+    h.byteOrder = kSnapshotByteOrder;
+    h.zoneCount = n;
+    h.nameBytes = nameBytes;
+    h.narrowRows = narrow.size() / kHours;
+    h.wideRows = wide.size() / kHours;
+
+    std::vector<char> payload(payloadWords(h) * 8, 0);
+    char* p = payload.data();
+    std::memcpy(p, cells.data(), n * sizeof(HourCell));
+    p += n * sizeof(HourCell);
+    std::memcpy(p, narrow.data(), narrow.size() * sizeof(uint32_t));
+    p += narrow.size() * sizeof(uint32_t);
+    std::memcpy(p, wide.data(), wide.size() * sizeof(long long));
+    char* offsets = payload.data() + cellWords(h) * 8;
+    char* names = offsets + ((n + 1) * 4 + 7) / 8 * 8;
+
+    uint32_t off = 0;
+    for (uint32_t id = 0; id < n; ++id) {
+        std::memcpy(offsets + id * sizeof(uint32_t), &off, sizeof(off));
+        std::string_view name = zones.name(id);
+        std::memcpy(names + off, name.data(), name.size());
+        off += (uint32_t)name.size();
+    }
+    std::memcpy(offsets + n * sizeof(uint32_t), &off, sizeof(off));
+    h.payloadBytes = payload.size();
+    h.checksum = snapshotChecksum(payload.data(), payload.size() / 8);
+
+    std::string tmp = path + ".tmp";
+    if (!writeDurably(tmp, h, payload) || std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        return false;
+    }
+#if TRIP_HAVE_MMAP
+    return syncParentDir(path);
+#else
+    return true;
+#endif
+}
+
+// Checks the header, sizes, checksum, counts and name offsets, then points
+// `out` into the bytes. Nothing is copied or hashed; see ZoneTable::thaw for
+// repeated names.
+static bool viewSnapshot(const char* data, size_t size, std::shared_ptr<const void> keep, FrozenTable& out) {
+    if (size < sizeof(SnapshotHeader)) return false;
+    SnapshotHeader h;
+    std::memcpy(&h, data, sizeof(h));
+    if (std::memcmp(h.magic, "TRIPSNAP", 8) != 0) return false;
+    if (h.version != kSnapshotVersion || h.byteOrder != kSnapshotByteOrder) return false;
+    if (h.payloadBytes != size - sizeof(h)) return false;
+
+    // bound the counts before doing arithmetic with them
+    uint64_t maxWords = h.payloadBytes / 8;
+    if (h.zoneCount >= UINT32_MAX || h.zoneCount > maxWords || h.narrowRows > h.zoneCount ||
+        h.wideRows > h.zoneCount || h.nameBytes > UINT32_MAX || h.nameBytes > h.payloadBytes) return false;
+    if (payloadWords(h) != maxWords || h.payloadBytes % 8 != 0) return false;
+
+    const char* payload = data + sizeof(h);
+    if (snapshotChecksum(payload, (size_t)maxWords) != h.checksum) return false;
+
+    FrozenTable t;
+    t.count = (uint32_t)h.zoneCount;
+    t.narrowRows = (size_t)h.narrowRows;
+    t.wideRows = (size_t)h.wideRows;
+    t.cells = (const HourCell*)payload;
+    t.narrow = (const uint32_t*)(t.cells + t.count);
+    t.wide = (const long long*)(t.narrow + t.narrowRows * ZoneTable::kHours);
+    t.nameOffsets = (const uint32_t*)(payload + cellWords(h) * 8);
+    t.names = (const char*)t.nameOffsets + (((size_t)t.count + 1) * 4 + 7) / 8 * 8;
+    if (t.nameOffsets[0] != 0 || t.nameOffsets[t.count] != h.nameBytes) return false;
+    for (uint32_t id = 0; id < t.count; ++id) {
+        if (t.nameOffsets[id] > t.nameOffsets[id + 1]) return false;
+    }
+    if (!checkCells(t)) return false;
+    t.keep = std::move(keep);
+    out = std::move(t);
+    return true;
+}
+
+static bool readSnapshot(const std::string& path, FrozenTable& out) {
+#if TRIP_HAVE_MMAP
+    auto file = std::make_shared<MappedFile>();
+    if (file->open(path)) {
+        const char* data = file->data();
+        size_t size = file->size();
+        return viewSnapshot(data, size, std::move(file), out);
+    }
+#endif
+    // no mmap: read into a malloc'd (suitably aligned, untyped) buffer instead
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in.is_open()) return false;
+    std::streamoff size = in.tellg();
+    if (size <= 0) return false;
+    std::shared_ptr<char> buf((char*)std::malloc((size_t)size), std::free);
+    if (!buf) return false;
+    in.seekg(0);
+    if (!in.read(buf.get(), size)) return false;
+    const char* data = buf.get();
+    return viewSnapshot(data, (size_t)size, std::move(buf), out);
+}
+
+// ------------------- follow mode -------------------
+
+// How far a followed file has been read. Only whole lines are consumed; a
+// last line without its '\n' stays in the file until the next poll.
+struct FollowState {
+    std::string path;
+    int fd = -1;
+    uint64_t dev = 0;
+    uint64_t ino = 0;
+    uint64_t offset = 0; // bytes of the open file already ingested
+    PieceReader pieces;
+    std::vector<char> buf;
+
+    FollowState() = default;
+    FollowState(const FollowState&) = delete;
+    FollowState& operator=(const FollowState&) = delete;
+    ~FollowState() { close(); }
+
+    void close() {
+#if TRIP_HAVE_MMAP
+        if (fd >= 0) ::close(fd);
+#endif
+        fd = -1;
+    }
+
+    // Start over at byte 0 of the open file, header included.
+    void rewind() {
+        offset = 0;
+        pieces.reset();
+    }
+
+    // Drop the followed file: the counts it was read into are gone, so the
+    // next poll starts it over as a first call.
+    void forget() {
+        close();
+        path.clear();
+        dev = ino = 0;
+        rewind();
+        buf = std::vector<char>();
+    }
+};
+
+#if TRIP_HAVE_MMAP
+// Ingest every complete line between the saved offset and the current end
+// of the open file, in 1 MiB reads. With `final` an unterminated last line
+// counts too: the file has been rotated away and will not grow any more.
+static size_t followRead(FollowState& f, bool final, ZoneTable& zones) {
+    const size_t kBlock = 1u << 20;
+    size_t consumed = 0;
+    size_t have = 0; // bytes read past f.offset and not yet ingested
+    for (;;) {
+        if (f.buf.size() < have + kBlock) f.buf.resize(have + kBlock);
+        ssize_t n = timedRead(zones, [&] { return ::pread(f.fd, f.buf.data() + have, kBlock, (off_t)(f.offset + have)); });
+        if (n < 0 && errno == EINTR) continue;
+        bool eof = n <= 0;
+        if (n > 0) have += (size_t)n;
+
+        const char* begin = f.buf.data();
+        const char* stop = begin + have;
+        if (!(eof && final)) {
+            while (stop > begin && stop[-1] != '\n') --stop;
+        }
+        size_t used = (size_t)(stop - begin);
+        if (used > 0) {
+            f.pieces.feed(begin, stop, CsvEngine::Lines, zones);
+            std::memmove(f.buf.data(), stop, have - used);
+            have -= used;
+            f.offset += used;
+            consumed += used;
+        }
+        if (eof) break;
+    }
+    return consumed;
+}
+
+static size_t followPoll(FollowState& f, const std::string& path, ZoneTable& zones) {
+    if (f.path != path) {
+        f.close();
+        f.path = path;
+    }
+
+    size_t consumed = 0;
+    struct stat st;
+    bool exists = ::stat(path.c_str(), &st) == 0;
+    if (f.fd >= 0 && (!exists || (uint64_t)st.st_dev != f.dev || (uint64_t)st.st_ino != f.ino)) {
+        // rotated: finish what is left of the old file, then switch
+        consumed += followRead(f, true, zones);
+        f.close();
+    }
+
+    if (f.fd < 0) {
+        if (!exists) return consumed;
+        f.fd = ::open(path.c_str(), O_RDONLY);
+        if (f.fd < 0) return consumed;
+        if (::fstat(f.fd, &st) != 0) {
+            f.close();
+            return consumed;
+        }
+        f.dev = (uint64_t)st.st_dev;
+        f.ino = (uint64_t)st.st_ino;
+        f.rewind();
+    } else if (::fstat(f.fd, &st) == 0 && (uint64_t)st.st_size < f.offset) {
+        f.rewind(); // truncated in place (copytruncate)
+    }
+    return consumed + followRead(f, false, zones);
+}
+#endif
+
+// ------------------- ranking -------------------
+
+// Keeps the k best items seen so far. The heap's front is the worst kept
+// item, so a candidate that does not make the cut costs one comparison and
+// a full query is O(m log k) time with O(k) space.
+template <class T, class Better>
+class TopK {
+public:
+    TopK(size_t k, Better better) : k_(k), better_(better) { heap_.reserve(k); }
+
+    void offer(const T& item) {
+        if (heap_.size() < k_) {
+            heap_.push_back(item);
+            std::push_heap(heap_.begin(), heap_.end(), better_);
+        } else if (k_ > 0 && better_(item, heap_.front())) {
+            std::pop_heap(heap_.begin(), heap_.end(), better_);
+            heap_.back() = item;
+            std::push_heap(heap_.begin(), heap_.end(), better_);
+        }
     }
 
-    auto cmp = [](const ZoneCount& a, const ZoneCount& b) {
-        if (a.count != b.count) return a.count > b.count; // count desc
-        return a.zone < b.zone;                           // zone asc
+    // Best first; leaves the collector empty.
+    std::vector<T> take() {
+        std::sort_heap(heap_.begin(), heap_.end(), better_);
+        return std::move(heap_);
+    }
+
+private:
+    size_t k_;
+    Better better_;
+    std::vector<T> heap_;
+};
+
+// One (zone, hour) cell of the table.
+struct SlotRef {
+    long long count;
+    uint32_t id;
+    int hour;
+};
+
+// LSD radix sort on a 64-bit key, one byte per pass. All eight histograms
+// come from one read of the input, and passes where every key has the same
+// byte (typically the high bytes) are skipped.
+template <class T, class Key>
+static void radixSort(std::vector<T>& v, Key key) {
+    if (v.size() < 2) return;
+    std::vector<size_t> counts(8 * 256, 0);
+    for (const T& x : v) {
+        uint64_t k = key(x);
+        for (int d = 0; d < 8; ++d) counts[d * 256 + ((k >> (8 * d)) & 0xFF)]++;
+    }
+
+    std::vector<T> tmp(v.size());
+    for (int d = 0; d < 8; ++d) {
+        size_t* count = &counts[d * 256];
+        if (count[(key(v[0]) >> (8 * d)) & 0xFF] == v.size()) continue;
+        size_t pos = 0;
+        for (int b = 0; b < 256; ++b) {
+            size_t c = count[b];
+            count[b] = pos;
+            pos += c;
+        }
+        for (const T& x : v) tmp[count[(key(x) >> (8 * d)) & 0xFF]++] = x;
+        v.swap(tmp);
+    }
+}
+
+// Zone ids in name order, and each id's place in it.
+struct LexOrder {
+    std::vector<uint32_t> byRank; // rank -> id
+    std::vector<uint32_t> rank;   // id -> rank
+    bool valid = false;
+
+    size_t bytes() const { return (byRank.capacity() + rank.capacity()) * sizeof(uint32_t); }
+};
+
+// Radix sorts the names on their first 8 bytes (big-endian, so integer order
+// is byte order); only ids whose prefixes tie are compared as strings.
+static void buildLexOrder(const ZoneTable& zones, LexOrder& lex) {
+    struct PrefixId {
+        uint64_t prefix;
+        uint32_t id;
     };
+    std::vector<PrefixId> v(zones.size());
+    for (uint32_t id = 0; id < zones.size(); ++id) {
+        std::string_view name = zones.name(id);
+        uint64_t prefix = 0;
+        for (size_t i = 0; i < 8; ++i) {
+            prefix <<= 8;
+            if (i < name.size()) prefix |= (unsigned char)name[i];
+        }
+        v[id] = {prefix, id};
+    }
+    radixSort(v, [](const PrefixId& x) { return x.prefix; });
 
-    if ((int)v.size() > k) {
-        std::partial_sort(v.begin(), v.begin() + k, v.end(), cmp);
-        v.resize(k);
-    } else {
-        std::sort(v.begin(), v.end(), cmp);
+    for (size_t i = 0; i < v.size();) {
+        size_t j = i + 1;
+        while (j < v.size() && v[j].prefix == v[i].prefix) ++j;
+        if (j - i > 1) {
+            std::sort(v.begin() + i, v.begin() + j, [&zones](const PrefixId& a, const PrefixId& b) {
+                return zones.name(a.id) < zones.name(b.id);
+            });
+        }
+        i = j;
     }
-    return v;
+
+    lex.byRank.resize(v.size());
+    lex.rank.resize(v.size());
+    for (uint32_t r = 0; r < v.size(); ++r) {
+        lex.byRank[r] = v[r].id;
+        lex.rank[v[r].id] = r;
+    }
+    lex.valid = true;
 }
 
-std::vector<SlotCount> TripAnalyzer::topBusySlots(int k) const {
-    if (k <= 0) return {};
+static int bitWidth(uint64_t x) {
+    int n = 0;
+    while (x) {
+        ++n;
+        x >>= 1;
+    }
+    return n;
+}
+
+// Bit layout of a packed ranking key, low to high: [hour][zone rank]
+// [maxCount - count]. Ascending keys are exactly count desc, zone asc,
+// hour asc, so ranking is integer selection with no string compares.
+struct KeyLayout {
+    int hourBits = 0;
+    int rankBits = 0;
+    long long maxCount = 0;
+    bool fits = false;
 
-    auto itObj = g_zoneHourTrips.find(this);
-    if (itObj == g_zoneHourTrips.end()) return {};
+    KeyLayout() = default;
+    KeyLayout(const ZoneTable& zones, int hourBits_) : hourBits(hourBits_) {
+        for (uint32_t id = 0; id < zones.size(); ++id) maxCount = std::max(maxCount, zones.total(id));
+        rankBits = bitWidth(zones.size() > 0 ? zones.size() - 1 : 0);
+        fits = hourBits + rankBits + bitWidth((uint64_t)maxCount) <= 64;
+    }
 
-    const auto& zoneHour = itObj->second;
+    uint64_t pack(long long count, uint32_t rank, int hour) const {
+        return ((uint64_t)(maxCount - count) << (rankBits + hourBits)) | ((uint64_t)rank << hourBits) |
+               (uint64_t)hour;
+    }
+    uint32_t rankOf(uint64_t key) const {
+        return (uint32_t)((key >> hourBits) & ((1ull << rankBits) - 1));
+    }
+};
 
-    std::vector<SlotCount> v;
-    v.reserve(zoneHour.size() * 24 / 2); // rough estimate
+// The k smallest keys produced by forEachKey, ascending. A shallow query
+// keeps a heap; a deep one collects every key and radix sorts them.
+template <class ForEachKey>
+static std::vector<uint64_t> smallestKeys(size_t n, size_t k, ForEachKey forEachKey) {
+    k = std::min(k, n);
+    if (k * 16 < n) {
+        TopK<uint64_t, std::less<uint64_t>> top(k, std::less<uint64_t>());
+        forEachKey([&top](uint64_t key) { top.offer(key); });
+        return top.take();
+    }
+    std::vector<uint64_t> keys;
+    keys.reserve(n);
+    forEachKey([&keys](uint64_t key) { keys.push_back(key); });
+    radixSort(keys, [](uint64_t key) { return key; });
+    if (keys.size() > k) keys.resize(k);
+    return keys;
+}
+
+// The k best zone ids: count desc, zone asc. With a name order the ids are
+// ranked as packed integer keys; without one, names are compared through
+// the table (never copied) on count ties.
+static std::vector<uint32_t> rankZones(const ZoneTable& zones, size_t k, const LexOrder* lex) {
+    KeyLayout layout = lex ? KeyLayout(zones, 0) : KeyLayout();
+    if (layout.fits) {
+        std::vector<uint64_t> keys = smallestKeys(zones.size(), k, [&](auto&& emit) {
+            for (uint32_t id = 0; id < zones.size(); ++id) emit(layout.pack(zones.total(id), lex->rank[id], 0));
+        });
+        std::vector<uint32_t> ids(keys.size());
+        for (size_t i = 0; i < keys.size(); ++i) ids[i] = lex->byRank[layout.rankOf(keys[i])];
+        return ids;
+    }
+
+    auto better = [&zones](uint32_t a, uint32_t b) {
+        if (zones.total(a) != zones.total(b)) return zones.total(a) > zones.total(b); // count desc
+        return zones.name(a) < zones.name(b);                                          // zone asc
+    };
+    TopK<uint32_t, decltype(better)> top(std::min<size_t>(k, zones.size()), better);
+    for (uint32_t id = 0; id < zones.size(); ++id) top.offer(id);
+    return top.take();
+}
 
-    for (const auto& kv : zoneHour) {
-        const std::string& zone = kv.first;
-        const auto& arr = kv.second;
-        for (int h = 0; h < 24; ++h) {
-            long long cnt = arr[h];
-            if (cnt > 0) v.push_back({zone, h, cnt});
+// The k best non-empty cells: count desc, zone asc, hour asc.
+static std::vector<SlotRef> rankSlots(const ZoneTable& zones, size_t k, const LexOrder* lex) {
+    size_t cells = zones.busyCells();
+    KeyLayout layout = lex ? KeyLayout(zones, 5) : KeyLayout();
+    if (layout.fits) {
+        std::vector<uint64_t> keys = smallestKeys(cells, k, [&](auto&& emit) {
+            for (uint32_t id = 0; id < zones.size(); ++id) {
+                uint32_t rank = lex->rank[id];
+                zones.forEachHour(id, [&](int h, long long c) { emit(layout.pack(c, rank, h)); });
+            }
+        });
+        std::vector<SlotRef> slots(keys.size());
+        for (size_t i = 0; i < keys.size(); ++i) {
+            uint32_t id = lex->byRank[layout.rankOf(keys[i])];
+            int hour = (int)(keys[i] & 31);
+            slots[i] = {zones.hourCount(id, hour), id, hour};
         }
+        return slots;
     }
 
-    auto cmp = [](const SlotCount& a, const SlotCount& b) {
-        if (a.count != b.count) return a.count > b.count; // count desc
-        if (a.zone != b.zone) return a.zone < b.zone;     // zone asc
-        return a.hour < b.hour;                           // hour asc
+    auto better = [&zones](const SlotRef& a, const SlotRef& b) {
+        if (a.count != b.count) return a.count > b.count;             // count desc
+        if (a.id != b.id) return zones.name(a.id) < zones.name(b.id); // zone asc
+        return a.hour < b.hour;                                       // hour asc
     };
+    TopK<SlotRef, decltype(better)> top(std::min<size_t>(k, cells), better);
+
+    for (uint32_t id = 0; id < zones.size(); ++id) {
+        zones.forEachHour(id, [&](int h, long long c) { top.offer({c, id, h}); });
+    }
+    return top.take();
+}
+
+// Best-first prefix of a ranking. A query for more than the prefix holds
+// reranks for at least twice as many, so a run of growing k costs O(m log k)
+// amortized and every query the prefix already covers is O(k).
+template <class T>
+struct RankPrefix {
+    std::vector<T> items;
+    bool complete = false; // the prefix is the whole ranking
+
+    template <class Rank>
+    const std::vector<T>& atLeast(size_t k, Rank rank) {
+        if (items.size() < k && !complete) {
+            size_t want = std::max(k, items.size() * 2);
+            items = rank(want);
+            complete = items.size() < want;
+        }
+        return items;
+    }
+
+    void clear() {
+        items = std::vector<T>();
+        complete = false;
+    }
+};
+
+// Per-instance aggregates, freed with the analyzer.
+struct TripAnalyzer::Impl {
+    ZoneTable zones;
+
+    // Rankings cached by the const queries, dropped on every ingest.
+    mutable std::mutex rankMutex;
+    bool cacheRankings = true;
+    mutable RankPrefix<uint32_t> zoneRank;
+    mutable RankPrefix<SlotRef> slotRank;
+    mutable LexOrder lex;
+
+    FollowState follow;
+
+    // Name order for packed ranking keys, or null. Building one sorts every
+    // name, which costs more than a shallow comparator-based query, so it is
+    // only built for deep queries and then kept while caching is on.
+    const LexOrder* lexOrder(size_t k, size_t candidates, LexOrder& scratch) const {
+        if (lex.valid) return &lex;
+        if (k * 16 < candidates) return nullptr;
+        LexOrder& out = cacheRankings ? lex : scratch;
+        buildLexOrder(zones, out);
+        return &out;
+    }
 
-    if ((int)v.size() > k) {
-        std::partial_sort(v.begin(), v.begin() + k, v.end(), cmp);
-        v.resize(k);
-    } else {
-        std::sort(v.begin(), v.end(), cmp);
+    void dropRankings() {
+        std::lock_guard<std::mutex> lock(rankMutex);
+        zoneRank.clear();
+        slotRank.clear();
+        lex = LexOrder();
     }
+
+    // Before an ingest: anything but an append replaces the table, and with
+    // it the counts a followed file's read position refers to.
+    void beginIngest(bool append) {
+        if (!append) {
+            zones.clear();
+            follow.forget();
+        }
+        dropRankings();
+    }
+};
+
+// ------------------- TripAnalyzer implementation -------------------
+
+TripAnalyzer::TripAnalyzer() : impl_(std::make_unique<Impl>()) {}
+TripAnalyzer::~TripAnalyzer() = default;
+TripAnalyzer::TripAnalyzer(TripAnalyzer&&) noexcept = default;
+TripAnalyzer& TripAnalyzer::operator=(TripAnalyzer&&) noexcept = default;
+
+void TripAnalyzer::ingestFile(const std::string& csvPath) {
+    ingestFile(csvPath, IngestOptions{});
+}
+
+void TripAnalyzer::ingestFile(const std::string& csvPath, const IngestOptions& opts) {
+    if (!impl_) impl_ = std::make_unique<Impl>(); // moved-from analyzers are reusable
+    auto& zones = impl_->zones;
+    impl_->beginIngest(opts.append);
+
+    if (opts.useMmap && ingestMapped(csvPath, opts, zones)) return;
+#if TRIP_HAVE_MMAP
+    if (opts.asyncRead && ingestPipelined(csvPath, opts.engine, readBlockBytes(opts), zones)) return;
+#endif
+    ingestGetline(csvPath, zones);
+}
+
+void TripAnalyzer::ingestFd(int fd) {
+    ingestFd(fd, IngestOptions{});
+}
+
+void TripAnalyzer::ingestFd(int fd, const IngestOptions& opts) {
+    if (!impl_) impl_ = std::make_unique<Impl>();
+    auto& zones = impl_->zones;
+    impl_->beginIngest(opts.append);
+
+#if TRIP_HAVE_MMAP
+    if (fd < 0) return;
+    if (opts.asyncRead) ingestDescriptorAsync(fd, opts.engine, readBlockBytes(opts), zones);
+    else ingestDescriptor(fd, opts.engine, readBlockBytes(opts), zones);
+#else
+    (void)fd;
+#endif
+}
+
+void TripAnalyzer::ingestStream(std::istream& in) {
+    ingestStream(in, IngestOptions{});
+}
+
+void TripAnalyzer::ingestStream(std::istream& in, const IngestOptions& opts) {
+    if (!impl_) impl_ = std::make_unique<Impl>();
+    auto& zones = impl_->zones;
+    impl_->beginIngest(opts.append);
+
+    ingestIstream(in, opts.engine, readBlockBytes(opts), zones);
+}
+
+void TripAnalyzer::ingestFiles(const std::vector<std::string>& paths) {
+    ingestFiles(paths, IngestOptions{});
+}
+
+void TripAnalyzer::ingestFiles(const std::vector<std::string>& paths, const IngestOptions& opts) {
+    if (!impl_) impl_ = std::make_unique<Impl>();
+    auto& zones = impl_->zones;
+    impl_->beginIngest(opts.append);
+
+    ingestMany(expandPaths(paths), opts, zones);
+}
+
+bool TripAnalyzer::saveSnapshot(const std::string& path) const {
+    if (!impl_) return writeSnapshot(ZoneTable(), path);
+    return writeSnapshot(impl_->zones, path);
+}
+
+bool TripAnalyzer::loadSnapshot(const std::string& path) {
+    FrozenTable frozen;
+    if (!readSnapshot(path, frozen)) return false;
+
+    if (!impl_) impl_ = std::make_unique<Impl>();
+    impl_->beginIngest(false);
+    impl_->zones.adopt(std::move(frozen));
+    return true;
+}
+
+size_t TripAnalyzer::pollFile(const std::string& csvPath) {
+    if (!impl_) impl_ = std::make_unique<Impl>();
+#if TRIP_HAVE_MMAP
+    size_t consumed = followPoll(impl_->follow, csvPath, impl_->zones);
+    if (consumed > 0) impl_->dropRankings();
+    return consumed;
+#else
+    (void)csvPath;
+    return 0;
+#endif
+}
+
+void TripAnalyzer::mergeFrom(const TripAnalyzer& other) {
+    if (!other.impl_) return;
+    if (!impl_) impl_ = std::make_unique<Impl>();
+    impl_->zones.merge(other.impl_->zones);
+    impl_->dropRankings();
+}
+
+std::vector<ZoneCount> TripAnalyzer::topZones(int k) const {
+    if (k <= 0) return {};
+
+    if (!impl_) return {};
+    const auto& zones = impl_->zones;
+    std::vector<ZoneCount> v;
+    std::lock_guard<std::mutex> lock(impl_->rankMutex);
+    LexOrder scratch;
+    auto rank = [&](size_t n) {
+        return rankZones(zones, n, impl_->lexOrder(n, zones.size(), scratch));
+    };
+    std::vector<uint32_t> uncached;
+    const std::vector<uint32_t>& ids = impl_->cacheRankings
+        ? impl_->zoneRank.atLeast((size_t)k, rank)
+        : (uncached = rank((size_t)k));
+
+    size_t n = std::min(ids.size(), (size_t)k);
+    v.reserve(n);
+    for (size_t i = 0; i < n; ++i) v.push_back({std::string(zones.name(ids[i])), zones.total(ids[i])});
+    return v;
+}
+
+std::vector<SlotCount> TripAnalyzer::topBusySlots(int k) const {
+    if (k <= 0) return {};
+
+    if (!impl_) return {};
+    const auto& zones = impl_->zones;
+    std::vector<SlotCount> v;
+    std::lock_guard<std::mutex> lock(impl_->rankMutex);
+    LexOrder scratch;
+    auto rank = [&](size_t n) {
+        return rankSlots(zones, n, impl_->lexOrder(n, zones.busyCells(), scratch));
+    };
+    std::vector<SlotRef> uncached;
+    const std::vector<SlotRef>& slots = impl_->cacheRankings
+        ? impl_->slotRank.atLeast((size_t)k, rank)
+        : (uncached = rank((size_t)k));
+
+    size_t n = std::min(slots.size(), (size_t)k);
+    v.reserve(n);
+    for (size_t i = 0; i < n; ++i) v.push_back({std::string(zones.name(slots[i].id)), slots[i].hour, slots[i].count});
     return v;
 }
+
+void TripAnalyzer::setRankingCache(bool enabled) {
+    if (!impl_) impl_ = std::make_unique<Impl>();
+    impl_->cacheRankings = enabled;
+    if (!enabled) impl_->dropRankings();
+}
+
+size_t TripAnalyzer::rankingCacheBytes() const {
+    if (!impl_) return 0;
+    std::lock_guard<std::mutex> lock(impl_->rankMutex);
+    return impl_->zoneRank.items.capacity() * sizeof(uint32_t) +
+           impl_->slotRank.items.capacity() * sizeof(SlotRef) + impl_->lex.bytes();
+}
+
+MemoryUsage TripAnalyzer::memoryUsage() const {
+    MemoryUsage usage;
+    if (!impl_) return usage;
+    impl_->zones.memory(usage);
+    usage.rankingCache = rankingCacheBytes();
+    usage.followBuffer = impl_->follow.buf.capacity();
+    return usage;
+}
+
+IngestStats TripAnalyzer::ingestStats() const {
+    IngestStats stats;
+#ifdef TRIP_ANALYZER_STATS
+    if (impl_) impl_->zones.report(stats);
+    stats.enabled = true;
+#endif
+    return stats;
+}
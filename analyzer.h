@@ -1,4 +1,7 @@
 #pragma once
+#include <cstddef>
+#include <iosfwd>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -13,14 +16,176 @@ struct SlotCount {
     long long count;
 };
 
+// How a mapped file is cut into rows and fields.
+enum class CsvEngine {
+    Lines, // memchr for each line end, then CsvTokenizer on the line
+    Simd,  // CsvScanner: SSE2/AVX2 (picked at runtime) bitmask scan of the whole buffer
+};
+
+// Knobs for ingestFile; the defaults are what the one-argument overload uses.
+struct IngestOptions {
+    // Map regular files and parse straight over the mapped bytes.
+    // Pipes and files that cannot be mapped fall back to the stream reader.
+    bool useMmap = true;
+
+    // Worker threads for a mapped file (0 = one per hardware thread). The file
+    // is cut at line boundaries into per-thread ranges; results do not depend
+    // on the count. Small files and the stream reader always run serially.
+    unsigned threads = 1;
+
+    // Row splitter for mapped files and the async reader; both give
+    // identical results.
+    CsvEngine engine = CsvEngine::Lines;
+
+    // For files that are not mapped: read on a helper thread into large
+    // buffers while this thread parses the previous one, instead of the
+    // getline loop. Useful on cold caches, where I/O and parsing overlap.
+    bool asyncRead = false;
+
+    // Add the file's rows to what the analyzer already holds instead of
+    // starting over, e.g. to ingest daily partitions one at a time.
+    bool append = false;
+
+    // Size of each read() of the async reader, ingestFd and ingestStream
+    // (0 = 4 MiB). Lines cut by a block edge are stitched back together, so
+    // results do not depend on it.
+    size_t readBlockBytes = 0;
+};
+
+// What ingest did, for finding where its time goes. Collected only when the
+// library is built with TRIP_ANALYZER_STATS (make STATS=1); otherwise
+// `enabled` is false, everything is zero and ingest does no bookkeeping.
+// Counters add up over appends, merges and parallel workers.
+struct IngestStats {
+    bool enabled = false;
+
+    long long bytesRead = 0;
+    long long rowsSeen = 0;          // non-empty lines after the header
+    long long rowsAccepted = 0;
+    long long rejectedFields = 0;    // fewer fields than the layout needs
+    long long rejectedEmptyZone = 0;
+    long long rejectedBadTime = 0;   // no hour could be read
+    long long rejectedHourRange = 0; // hour read but not 0-23 (1-12 with AM/PM)
+
+    // Milliseconds per phase, summed over threads. Read covers read() calls
+    // only: a mapped file is paged in while it is tokenized. Tokenize, hour
+    // and hash are estimated by timing one row in 64; rehash is timed in
+    // full. With the SIMD engine a row's tokenize time runs from the end of
+    // the previous row, so it includes classifying the 64-byte blocks the
+    // row shares with its neighbours.
+    double readMs = 0;
+    double tokenizeMs = 0;
+    double hourMs = 0;
+    double hashMs = 0;
+    double rehashMs = 0;
+
+    size_t zones = 0;
+    double loadFactor = 0; // zones / hash slots
+    size_t rehashes = 0;
+
+    // Hot-zone cache in front of the index; it switches itself off (and
+    // stops counting lookups) while zones rarely repeat.
+    long long frontCacheLookups = 0;
+    long long frontCacheHits = 0;
+    double frontCacheHitRate = 0;
+};
+
+// Bytes an analyzer holds, by structure. Figures are allocated capacity,
+// so right after a container grows they run ahead of what is in use.
+struct MemoryUsage {
+    size_t zoneIndex = 0;    // hash slots of the zone dictionary
+    size_t zoneNames = 0;    // interned zone names
+    size_t zoneCells = 0;    // per-zone total and inline (hour, count) pairs
+    size_t denseHours = 0;   // 24-counter rows of zones seen at many hours
+    size_t snapshot = 0;     // a loaded snapshot, queried in place
+    size_t rankingCache = 0; // see setRankingCache
+    size_t followBuffer = 0; // pollFile's read buffer
+
+    size_t total() const {
+        return zoneIndex + zoneNames + zoneCells + denseHours + snapshot + rankingCache + followBuffer;
+    }
+};
+
+// All aggregates live in the instance; separate analyzers share nothing and
+// can be used from different threads at the same time.
 class TripAnalyzer {
 public:
+    TripAnalyzer();
+    ~TripAnalyzer();
+    TripAnalyzer(TripAnalyzer&&) noexcept;
+    TripAnalyzer& operator=(TripAnalyzer&&) noexcept;
+
     // Parse Trips.csv, skip dirty rows, never crash
     void ingestFile(const std::string& csvPath);
+    void ingestFile(const std::string& csvPath, const IngestOptions& opts);
+
+    // Same, for data that has no path: a pipe, a socket, stdin (fd 0). The
+    // descriptor is read to EOF in opts.readBlockBytes blocks (on a helper
+    // thread with opts.asyncRead) and is not closed. useMmap and threads do
+    // not apply.
+    void ingestFd(int fd);
+    void ingestFd(int fd, const IngestOptions& opts);
+
+    // Same, for an already open std::istream, read in opts.readBlockBytes blocks.
+    void ingestStream(std::istream& in);
+    void ingestStream(std::istream& in, const IngestOptions& opts);
+
+    // Ingest several files concurrently; entries may be glob patterns such as
+    // "2024-01-01/*.csv" (an entry naming an existing file is read as that
+    // file, wildcard characters and all). Up to opts.threads workers (0 = one
+    // per hardware thread) share the files, and large files are split so they
+    // spread over all of them. That holds with useMmap off too: the ranges
+    // are then read in opts.readBlockBytes blocks, on helper threads when
+    // opts.asyncRead is set. Pipes are read whole. Results match ingesting
+    // the files one by one in order.
+    void ingestFiles(const std::vector<std::string>& paths);
+    void ingestFiles(const std::vector<std::string>& paths, const IngestOptions& opts);
+
+    // Follow a growing CSV: each call adds the complete lines appended to
+    // csvPath since the previous call (the first call reads the whole file)
+    // to the current counts. A last line without '\n' waits for the next
+    // call. A file truncated in place is read again from byte 0; after a
+    // rotation the rest of the old file is read, then the new one from the
+    // start. Any ingest other than an append, and loadSnapshot, replace the
+    // counts and forget the followed file, so the next call is a first call
+    // again. Returns the bytes consumed; the caller picks the poll interval.
+    size_t pollFile(const std::string& csvPath);
+
+    // Write the aggregates to a versioned, checksummed binary file, replacing
+    // `path` atomically. Returns false if it could not be written.
+    bool saveSnapshot(const std::string& path) const;
+
+    // Replace the aggregates with a snapshot's. The file is mapped and
+    // queried in place, without building the zone index; a later ingest or
+    // merge copies it into memory first, and a zone name the file repeats is
+    // counted as one zone from then on. Returns false, leaving the analyzer
+    // untouched, if the file is missing, from another version or damaged.
+    bool loadSnapshot(const std::string& path);
+
+    // Add other's counts to this analyzer's; linear in other's distinct zones.
+    void mergeFrom(const TripAnalyzer& other);
 
     // Top K zones: count desc, zone asc
     std::vector<ZoneCount> topZones(int k = 10) const;
 
     // Top K slots: count desc, zone asc, hour asc
     std::vector<SlotCount> topBusySlots(int k = 10) const;
+
+    // The first query after an ingest ranks a sorted prefix (at least k deep)
+    // and keeps it; later queries the prefix covers are O(k). Ingesting drops
+    // it. Disabling frees the cache and ranks every query from scratch.
+    void setRankingCache(bool enabled);
+
+    // Bytes currently held by the cached rankings.
+    size_t rankingCacheBytes() const;
+
+    // What the analyzer's data structures hold in memory; see MemoryUsage.
+    MemoryUsage memoryUsage() const;
+
+    // Statistics of the ingests behind the current counts; see IngestStats.
+    IngestStats ingestStats() const;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
 };
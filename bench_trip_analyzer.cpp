@@ -0,0 +1,288 @@
+#include "catch_amalgamated.hpp"
+#include "analyzer.h"
+#include "csv_tokenizer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Throughput benchmarks for the C1-C3 input shapes at BENCH_SCALE (default
+// 10, up to 100) times the sizes the C tests use. Run through `make bench`.
+//
+// Inputs are generated straight to a temporary file in 1 MiB blocks, so
+// memory stays flat at any scale (C3 at 100x is a 7 GB file, not 7 GB of
+// RAM). The ingest benchmarks read that file; the parse-only and sample
+// ones run over its first kSampleBytes, kept in memory.
+//
+// Catch prints the time per run; the listener below adds rows/s, MB/s and
+// ns/row for each benchmark, using the work registered under its name.
+
+namespace fs = std::filesystem;
+
+// -------------------- work accounting --------------------
+struct Work {
+    double rows;
+    double bytes;
+};
+
+static std::map<std::string, Work>& registry() {
+    static std::map<std::string, Work> work;
+    return work;
+}
+
+// Records the work one run of benchmark `name` does; returns the name.
+static std::string named(const std::string& name, double rows, double bytes) {
+    registry()[name] = {rows, bytes};
+    return name;
+}
+
+class ThroughputListener : public Catch::EventListenerBase {
+public:
+    using Catch::EventListenerBase::EventListenerBase;
+
+    void benchmarkEnded(Catch::BenchmarkStats<> const& stats) override {
+        auto it = registry().find(stats.info.name);
+        if (it == registry().end()) return;
+        double ns = stats.mean.point.count();
+        const Work& w = it->second;
+        char mb[32] = "";
+        if (w.bytes > 0) std::snprintf(mb, sizeof(mb), "%9.1f MB/s", w.bytes / ns * 1e3);
+        char line[160];
+        std::snprintf(line, sizeof(line), "  %-32s %10.2f Mrows/s %14s %8.2f ns/row\n",
+                      stats.info.name.c_str(), w.rows / ns * 1e3, mb, ns / w.rows);
+        lines_ += line;
+    }
+
+    // printed after the test case so the lines don't interleave with Catch's table
+    void testCaseEnded(Catch::TestCaseStats const&) override {
+        if (lines_.empty()) return;
+        std::cout << "\nthroughput:\n" << lines_ << std::flush;
+        lines_.clear();
+    }
+
+private:
+    std::string lines_;
+};
+CATCH_REGISTER_LISTENER(ThroughputListener)
+
+// -------------------- datasets --------------------
+static int benchScale() {
+    const char* v = std::getenv("BENCH_SCALE");
+    int s = v ? std::atoi(v) : 10;
+    return s < 1 ? 1 : (s > 100 ? 100 : s);
+}
+
+static std::string zpad(long long n, int width) {
+    std::string s = std::to_string(n);
+    if ((int)s.size() >= width) return s;
+    return std::string(width - (int)s.size(), '0') + s;
+}
+
+static const size_t kBlockBytes = 1u << 20;
+static const size_t kSampleBytes = 64u << 20;
+
+struct Dataset {
+    std::string path;
+    long long rows = 0;
+    double bytes = 0;       // size of the file
+    std::string sample;     // its first whole blocks, up to kSampleBytes
+    long long sampleRows = 0;
+};
+
+// Rows are produced by `row(i, out)` and written in kBlockBytes blocks.
+template <class Row>
+static Dataset makeDataset(const std::string& name, long long rows, Row row) {
+    Dataset d;
+    d.path = (fs::temp_directory_path() / ("trip_bench_" + name + ".csv")).string();
+    d.rows = rows;
+    std::ofstream out(d.path, std::ios::binary);
+
+    std::string block = "TripID,PickupZoneID,PickupTime\n";
+    block.reserve(kBlockBytes + 256);
+    long long blockRows = 0;
+    bool sampling = true;
+    auto flush = [&] {
+        out.write(block.data(), (std::streamsize)block.size());
+        d.bytes += (double)block.size();
+        sampling = sampling && d.sample.size() + block.size() <= kSampleBytes;
+        if (sampling) {
+            d.sample += block;
+            d.sampleRows += blockRows;
+        }
+        block.clear();
+        blockRows = 0;
+    };
+    for (long long i = 0; i < rows; i++) {
+        row(i, block);
+        blockRows++;
+        if (block.size() >= kBlockBytes) flush();
+    }
+    flush();
+    out.close();
+    REQUIRE(out.good()); // a full disk would otherwise time a truncated file
+    return d;
+}
+
+// C1: every row a new zone
+static Dataset highCardinality(long long rows) {
+    return makeDataset("c1", rows, [](long long i, std::string& out) {
+        out += std::to_string(i + 1) + ",Z" + zpad(i, 8) + ",2024-01-01 01:00\n";
+    });
+}
+
+// C2: four zones, hours cycling
+static Dataset fewKeys(long long rows) {
+    return makeDataset("c2", rows, [](long long i, std::string& out) {
+        out += std::to_string(i + 1) + ",Z" + std::to_string(i & 3) + ",2024-01-01 " + zpad(i % 24, 2) + ":00\n";
+    });
+}
+
+// C3: one dominant slot on top of five zones over all hours
+static Dataset mixed(long long rows) {
+    long long boost = rows / 13;
+    return makeDataset("c3", rows, [boost](long long i, std::string& out) {
+        if (i < boost) {
+            out += std::to_string(i + 1) + ",Z2,2024-01-01 07:15\n";
+        } else {
+            out += std::to_string(i + 1) + ",Z" + std::to_string(i % 5) + ",2024-01-01 " + zpad(i % 24, 2) + ":00\n";
+        }
+    });
+}
+
+// -------------------- phases --------------------
+
+// Parsing alone: split every row into fields, count them.
+static long long parseLines(const std::string& bytes) {
+    CsvTokenizer tok;
+    long long fields = 0;
+    size_t p = 0;
+    while (p < bytes.size()) {
+        size_t nl = bytes.find('\n', p);
+        if (nl == std::string::npos) nl = bytes.size();
+        fields += (long long)tok.split(std::string_view(bytes.data() + p, nl - p));
+        p = nl + 1;
+    }
+    return fields;
+}
+
+static long long parseSimd(const std::string& bytes) {
+    CsvScanner scanner;
+    long long fields = 0;
+    scanner.scan(bytes.data(), bytes.size(), [&](const std::string_view*, size_t n) { fields += (long long)n; });
+    return fields;
+}
+
+// The sample through TripAnalyzer from memory: the production parse and
+// zone table, without the file reads "ingest" also pays for. Aggregation
+// alone costs about this minus "parse lines".
+class SampleBuf : public std::streambuf {
+public:
+    explicit SampleBuf(const std::string& bytes) {
+        char* p = const_cast<char*>(bytes.data());
+        setg(p, p, p + bytes.size());
+    }
+};
+
+static size_t ingestSample(const std::string& bytes) {
+    SampleBuf buf(bytes);
+    std::istream in(&buf);
+    TripAnalyzer a;
+    a.ingestStream(in);
+    return a.topZones(1).size();
+}
+
+// The same tokenizer feeding std::unordered_map, the structure ZoneIndex
+// replaced: one std::string key per row, since C++17 has no heterogeneous
+// lookup for it. It skips the trimming and time checks ingest does, so it
+// is a floor for the map rather than a like-for-like run.
+static long long ingestSampleStdMap(const std::string& bytes) {
+    struct Record {
+        long long total = 0;
+        long long hours[24] = {};
+    };
+    std::unordered_map<std::string, Record> index;
+    CsvTokenizer tok;
+    size_t p = bytes.find('\n') + 1; // skip header
+    while (p < bytes.size()) {
+        size_t nl = bytes.find('\n', p);
+        if (nl == std::string::npos) nl = bytes.size();
+        if (tok.split(std::string_view(bytes.data() + p, nl - p)) >= 3 && tok[2].size() >= 13) {
+            Record& r = index.try_emplace(std::string(tok[1])).first->second;
+            r.total++;
+            r.hours[(tok[2][11] - '0') * 10 + (tok[2][12] - '0')]++;
+        }
+        p = nl + 1;
+    }
+    return (long long)index.size();
+}
+
+static void benchShape(const std::string& shape, const Dataset& d) {
+    double rows = (double)d.rows;
+    double bytes = d.bytes;
+    double sampleRows = (double)d.sampleRows;
+    double sampleBytes = (double)d.sample.size();
+
+    BENCHMARK(named("parse lines " + shape, sampleRows, sampleBytes)) { return parseLines(d.sample); };
+    BENCHMARK(named("parse simd " + shape, sampleRows, sampleBytes)) { return parseSimd(d.sample); };
+
+    BENCHMARK(named("ingest sample " + shape, sampleRows, sampleBytes)) { return ingestSample(d.sample); };
+    BENCHMARK(named("ingest sample unordered_map " + shape, sampleRows, sampleBytes)) {
+        return ingestSampleStdMap(d.sample);
+    };
+
+    BENCHMARK(named("ingest " + shape, rows, bytes)) {
+        TripAnalyzer a;
+        a.ingestFile(d.path);
+        return a.topZones(1).size();
+    };
+
+    // the multi-file pool with one worker per hardware thread, which splits
+    // the one file into ranges; compare with "ingest" for the scaling
+    IngestOptions pooled;
+    pooled.threads = 0;
+    std::string cores = std::to_string(std::max(1u, std::thread::hardware_concurrency()));
+    BENCHMARK(named("ingestFiles x" + cores + " " + shape, rows, bytes)) {
+        TripAnalyzer a;
+        a.ingestFiles({d.path}, pooled);
+        return a.topZones(1).size();
+    };
+
+    // queries rank from scratch on every run; their "rows" are the zones or
+    // slots ranked, and they read no input bytes
+    TripAnalyzer a;
+    a.setRankingCache(false);
+    a.ingestFile(d.path);
+    double nZones = (double)a.topZones(INT_MAX).size();
+    double nSlots = (double)a.topBusySlots(INT_MAX).size();
+    BENCHMARK(named("topZones(10) " + shape, nZones, 0)) { return a.topZones(10); };
+    BENCHMARK(named("topBusySlots(10) " + shape, nSlots, 0)) { return a.topBusySlots(10); };
+
+    std::remove(d.path.c_str());
+}
+
+// -------------------- benchmarks --------------------
+TEST_CASE("B-C1 high cardinality", "[bench]") {
+    long long rows = 150000LL * benchScale();
+    benchShape("C1x" + std::to_string(benchScale()), highCardinality(rows));
+}
+
+TEST_CASE("B-C2 few keys, many rows", "[bench]") {
+    long long rows = 2000000LL * benchScale();
+    benchShape("C2x" + std::to_string(benchScale()), fewKeys(rows));
+}
+
+TEST_CASE("B-C3 mixed volume, dominant slot", "[bench]") {
+    long long rows = 2700000LL * benchScale();
+    benchShape("C3x" + std::to_string(benchScale()), mixed(rows));
+}
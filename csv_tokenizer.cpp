@@ -0,0 +1,216 @@
+#include "csv_tokenizer.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CSV_HAVE_X86 1
+#else
+#define CSV_HAVE_X86 0
+#endif
+
+size_t CsvTokenizer::split(std::string_view line, size_t limit) {
+    fields_.clear();
+    hasRest_ = false;
+    if (limit == 0) {
+        rest_ = line;
+        hasRest_ = true;
+        return 0;
+    }
+    if (std::memchr(line.data(), '"', line.size()) != nullptr) return splitQuoted(line, limit);
+
+    const char* p = line.data();
+    const char* end = p + line.size();
+    while (fields_.size() < limit) {
+        const char* comma = (const char*)std::memchr(p, ',', (size_t)(end - p));
+        if (comma == nullptr) {
+            if (p < end) fields_.emplace_back(p, (size_t)(end - p));
+            return fields_.size();
+        }
+        fields_.emplace_back(p, (size_t)(comma - p));
+        p = comma + 1;
+    }
+    rest_ = std::string_view(p, (size_t)(end - p));
+    hasRest_ = true;
+    return fields_.size();
+}
+
+// Unquoting can only shrink a field, so one buffer as long as the line holds
+// every field of it. Sizing it up front keeps the views stable.
+size_t CsvTokenizer::splitQuoted(std::string_view line, size_t limit) {
+    if (unquoted_.size() < line.size()) unquoted_.resize(line.size());
+    char* const base = &unquoted_[0];
+    char* out = base;
+    char* fieldStart = base;
+    bool inQuotes = false;
+
+    for (size_t i = 0; i < line.size(); ++i) {
+        char ch = line[i];
+
+        if (!inQuotes && ch == ',') {
+            fields_.emplace_back(fieldStart, (size_t)(out - fieldStart));
+            fieldStart = out;
+            if (fields_.size() == limit) {
+                rest_ = line.substr(i + 1);
+                hasRest_ = true;
+                return fields_.size();
+            }
+            continue;
+        }
+
+        if (ch == '"') {
+            if (!inQuotes) {
+                inQuotes = true;
+                continue;
+            }
+            if (i + 1 < line.size() && line[i + 1] == '"') {
+                *out++ = '"';
+                ++i;
+                continue;
+            }
+            inQuotes = false;
+            continue;
+        }
+
+        *out++ = ch;
+    }
+
+    if (out != fieldStart || inQuotes) fields_.emplace_back(fieldStart, (size_t)(out - fieldStart));
+    return fields_.size();
+}
+
+bool CsvTokenizer::hasMoreFields(size_t n) const {
+    if (n == 0) return true;
+    if (!hasRest_) return false;
+
+    // rest_ starts right after a separating comma, so outside quotes
+    size_t commas = 0;
+    bool inQuotes = false;
+    bool segmentHasData = false; // would the field after the last comma be non-empty
+    for (size_t i = 0; i < rest_.size(); ++i) {
+        char ch = rest_[i];
+        if (!inQuotes && ch == ',') {
+            if (++commas == n) return true;
+            segmentHasData = false;
+        } else if (ch != '"') {
+            segmentHasData = true;
+        } else if (!inQuotes) {
+            inQuotes = true;
+        } else if (i + 1 < rest_.size() && rest_[i + 1] == '"') {
+            segmentHasData = true;
+            ++i;
+        } else {
+            inQuotes = false;
+        }
+    }
+    // the last field only counts if split() would have reported it
+    return commas + 1 == n && (segmentHasData || inQuotes);
+}
+
+size_t unquoteCsvField(const char* p, size_t n, char* out, bool& openAtEnd) {
+    char* o = out;
+    bool inQuotes = false;
+    for (size_t i = 0; i < n; ++i) {
+        char ch = p[i];
+        if (ch != '"') {
+            *o++ = ch;
+        } else if (!inQuotes) {
+            inQuotes = true;
+        } else if (i + 1 < n && p[i + 1] == '"') {
+            *o++ = '"';
+            ++i;
+        } else {
+            inQuotes = false;
+        }
+    }
+    openAtEnd = inQuotes;
+    return (size_t)(o - out);
+}
+
+// ------------------- CsvScanner -------------------
+
+static void classifyScalar(const char* p, CsvScanner::Masks& m) {
+    uint64_t comma = 0, quote = 0, newline = 0;
+    for (int i = 0; i < 64; ++i) {
+        uint64_t bit = (uint64_t)1 << i;
+        char c = p[i];
+        if (c == ',') comma |= bit;
+        else if (c == '"') quote |= bit;
+        else if (c == '\n') newline |= bit;
+    }
+    m.comma = comma;
+    m.quote = quote;
+    m.newline = newline;
+}
+
+#if CSV_HAVE_X86
+__attribute__((target("sse2")))
+static void classifySse2(const char* p, CsvScanner::Masks& m) {
+    const __m128i comma = _mm_set1_epi8(',');
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i newline = _mm_set1_epi8('\n');
+    uint64_t c = 0, q = 0, n = 0;
+    for (int i = 0; i < 4; ++i) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(p + 16 * i));
+        c |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, comma)) << (16 * i);
+        q |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, quote)) << (16 * i);
+        n |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, newline)) << (16 * i);
+    }
+    m.comma = c;
+    m.quote = q;
+    m.newline = n;
+}
+
+__attribute__((target("avx2")))
+static void classifyAvx2(const char* p, CsvScanner::Masks& m) {
+    const __m256i comma = _mm256_set1_epi8(',');
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i newline = _mm256_set1_epi8('\n');
+    __m256i lo = _mm256_loadu_si256((const __m256i*)p);
+    __m256i hi = _mm256_loadu_si256((const __m256i*)(p + 32));
+    auto mask = [](__m256i a, __m256i b, __m256i needle) __attribute__((target("avx2"))) {
+        uint64_t l = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, needle));
+        uint64_t h = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(b, needle));
+        return l | (h << 32);
+    };
+    m.comma = mask(lo, hi, comma);
+    m.quote = mask(lo, hi, quote);
+    m.newline = mask(lo, hi, newline);
+}
+#endif
+
+CsvIsa detectCsvIsa() {
+#if CSV_HAVE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return CsvIsa::Avx2;
+    if (__builtin_cpu_supports("sse2")) return CsvIsa::Sse2;
+#endif
+    return CsvIsa::Scalar;
+}
+
+CsvScanner::CsvScanner(CsvIsa isa) : isa_(std::min(isa, detectCsvIsa())), classify_(classifyScalar) {
+#if CSV_HAVE_X86
+    if (isa_ == CsvIsa::Avx2) classify_ = classifyAvx2;
+    else if (isa_ == CsvIsa::Sse2) classify_ = classifySse2;
+#endif
+}
+
+// Rows with a quote keep the bulk field boundaries; only the fields that
+// contain a quote are rewritten, into a buffer as long as the line.
+void CsvScanner::unquoteRow(size_t lineLen) {
+    if (unquoted_.size() < lineLen) unquoted_.resize(lineLen);
+    char* out = &unquoted_[0];
+
+    bool openAtEnd = false;
+    for (auto& f : fields_) {
+        openAtEnd = false;
+        if (std::memchr(f.data(), '"', f.size()) == nullptr) continue;
+        size_t n = unquoteCsvField(f.data(), f.size(), out, openAtEnd);
+        f = std::string_view(out, n);
+        out += n;
+    }
+
+    // same trailing-field rule as CsvTokenizer
+    if (!fields_.empty() && fields_.back().empty() && !openAtEnd) fields_.pop_back();
+}
@@ -0,0 +1,181 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Splits one CSV line (terminator already stripped) into field views.
+//
+// Quoting rules: a '"' outside quotes opens a quoted run, a '"' inside one
+// closes it, and '""' inside quotes is a literal quote. Quotes may appear
+// anywhere in a field. A trailing empty field is dropped unless the line
+// ends inside quotes, so "a,b," has two fields.
+//
+// The tokenizer keeps its buffers between calls, so once it has seen the
+// widest line of a file, splitting does not touch the heap.
+class CsvTokenizer {
+public:
+    // Returns the number of fields. The views point into `line` or into
+    // the tokenizer's own buffer and stay valid until the next split().
+    //
+    // With a limit, splitting stops after that many fields and the rest of
+    // the line is left unparsed; hasMoreFields() can still tell whether it
+    // holds enough fields, without materializing them.
+    size_t split(std::string_view line, size_t limit = SIZE_MAX);
+
+    // True if the part of the line after the last split field holds at
+    // least n more fields (same counting rules as split()).
+    bool hasMoreFields(size_t n) const;
+
+    size_t size() const { return fields_.size(); }
+    std::string_view operator[](size_t i) const { return fields_[i]; }
+    const std::string_view* data() const { return fields_.data(); }
+
+private:
+    size_t splitQuoted(std::string_view line, size_t limit);
+
+    std::vector<std::string_view> fields_;
+    std::string unquoted_; // backing bytes for fields of quoted lines
+    std::string_view rest_;  // text after the comma that ended the last field
+    bool hasRest_ = false;   // false when split() reached the end of the line
+};
+
+// Unquotes one raw field (no unquoted commas inside) into `out`, which must
+// have room for n bytes. Returns the unquoted length; `openAtEnd` reports
+// whether the field ended inside quotes.
+size_t unquoteCsvField(const char* p, size_t n, char* out, bool& openAtEnd);
+
+// Byte classifier behind CsvScanner, picked once at runtime.
+enum class CsvIsa { Scalar, Sse2, Avx2 };
+
+// Best classifier the running CPU supports.
+CsvIsa detectCsvIsa();
+
+// Splits a whole buffer into rows and fields 64 bytes at a time.
+//
+// Each block is turned into bitmasks of ',', '"' and '\n'. A prefix XOR
+// over the quote mask marks the quoted regions, so the unquoted commas and
+// the newlines fall out as one mask and are walked with count-trailing-zeros
+// instead of a branch per byte. Rows follow the std::getline + CsvTokenizer
+// rules exactly: every '\n' ends a row (an open quote does not carry over),
+// one trailing '\r' is dropped, empty lines are skipped.
+// A line that splits into no fields at all (only `""`) is still a row, so
+// callers count and reject it just as they would a short line.
+class CsvScanner {
+public:
+    struct Masks {
+        uint64_t comma;
+        uint64_t quote;
+        uint64_t newline;
+    };
+
+    // An unsupported isa is clamped to the best one the CPU has.
+    explicit CsvScanner(CsvIsa isa = detectCsvIsa());
+
+    CsvIsa isa() const { return isa_; }
+
+    // Calls onRow(const std::string_view* fields, size_t count) for every
+    // non-empty line; count may be 0. Views are valid during the call only.
+    template <class OnRow>
+    void scan(const char* data, size_t size, OnRow&& onRow);
+
+private:
+    using ClassifyFn = void (*)(const char* block, Masks& out);
+
+    // inclusive prefix XOR: bit i = parity of quote bits 0..i
+    static uint64_t prefixXor(uint64_t x) {
+        x ^= x << 1;
+        x ^= x << 2;
+        x ^= x << 4;
+        x ^= x << 8;
+        x ^= x << 16;
+        x ^= x << 32;
+        return x;
+    }
+
+    void unquoteRow(size_t lineLen);
+
+    CsvIsa isa_;
+    ClassifyFn classify_;
+    std::vector<std::string_view> fields_;
+    std::string unquoted_;
+};
+
+template <class OnRow>
+void CsvScanner::scan(const char* data, size_t size, OnRow&& onRow) {
+    fields_.clear();
+    size_t lineStart = 0;
+    size_t fieldStart = 0;
+    bool rowQuoted = false;
+    uint64_t carry = 0; // all ones while a quoted region runs over a block edge
+
+    auto endRow = [&](size_t lineEnd) {
+        if (lineEnd > lineStart && data[lineEnd - 1] == '\r') --lineEnd;
+        if (lineEnd > lineStart) {
+            // a trailing empty field is dropped; unquoteRow applies the rule itself
+            if (lineEnd > fieldStart || rowQuoted) {
+                fields_.emplace_back(data + fieldStart, lineEnd - fieldStart);
+            }
+            if (rowQuoted) unquoteRow(lineEnd - lineStart);
+            onRow(fields_.data(), fields_.size());
+        }
+        fields_.clear();
+        rowQuoted = false;
+    };
+
+    char tail[64];
+    for (size_t base = 0; base < size; base += 64) {
+        const char* block = data + base;
+        if (size - base < 64) {
+            std::memcpy(tail, block, size - base);
+            std::memset(tail + (size - base), 0, 64 - (size - base));
+            block = tail;
+        }
+
+        Masks m;
+        classify_(block, m);
+
+        if ((m.quote | carry) == 0) {
+            // no quoting anywhere near this block: commas and newlines are all structural
+            for (uint64_t events = m.comma | m.newline; events != 0; events &= events - 1) {
+                size_t pos = base + (size_t)__builtin_ctzll(events);
+                if (m.newline & (events & (0 - events))) {
+                    endRow(pos);
+                    lineStart = fieldStart = pos + 1;
+                } else {
+                    fields_.emplace_back(data + fieldStart, pos - fieldStart);
+                    fieldStart = pos + 1;
+                }
+            }
+            continue;
+        }
+
+        uint64_t inQuotes = prefixXor(m.quote) ^ carry;
+        // a row that ends inside quotes must not leak the open quote into the next one
+        for (uint64_t nl = m.newline & inQuotes; nl != 0; nl = m.newline & inQuotes) {
+            uint64_t bit = nl & (0 - nl);
+            inQuotes ^= 0 - bit;
+        }
+        carry = 0 - (inQuotes >> 63);
+
+        uint64_t events = (m.comma & ~inQuotes) | m.newline | m.quote;
+        while (events != 0) {
+            uint64_t bit = events & (0 - events);
+            size_t pos = base + (size_t)__builtin_ctzll(events);
+            events ^= bit;
+
+            if (m.quote & bit) {
+                rowQuoted = true;
+            } else if (m.newline & bit) {
+                endRow(pos);
+                lineStart = fieldStart = pos + 1;
+            } else {
+                fields_.emplace_back(data + fieldStart, pos - fieldStart);
+                fieldStart = pos + 1;
+            }
+        }
+    }
+    if (lineStart < size) endRow(size);
+}
@@ -0,0 +1,406 @@
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Synthetic trip CSV generator. Streams rows straight to a file or stdout,
+// so the output size is bounded by the disk, not by memory.
+//
+// Usage: gen_trips [options] [-o out.csv]
+//   --rows N          rows to write (default 1000000)
+//   --zones N         zone cardinality (default 1000, at most 2^32 - 1)
+//   --dist D          zipf[:s] (default s = 1.0), uniform, or hot[:p]
+//                     (one zone gets share p of the rows, default 0.5,
+//                     and the others share the rest uniformly)
+//   --columns 3|6     TripID,PickupZoneID,PickupTime or the full
+//                     six-column layout of SmallTrips.csv (default 6)
+//   --dirty R         share of rows that are dirty (default 0)
+//   --dirty-kinds K   comma list of missing, badtime, quoted, crlf
+//                     (default all); a dirty row gets one of them
+//   --seed N          RNG seed (default 1); same options => same bytes
+//   --no-header       omit the header row
+//
+// "quoted" and "crlf" rows are still valid trips; "missing" and "badtime"
+// rows must be rejected by the reader.
+
+// -------------------- random numbers --------------------
+// xoshiro256**, seeded through splitmix64
+class Rng {
+public:
+    explicit Rng(uint64_t seed) {
+        for (uint64_t& w : s_) {
+            seed += 0x9E3779B97F4A7C15ull;
+            uint64_t z = seed;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            w = z ^ (z >> 31);
+        }
+    }
+
+    uint64_t next() {
+        uint64_t r = rotl(s_[1] * 5, 7) * 9;
+        uint64_t t = s_[1] << 17;
+        s_[2] ^= s_[0];
+        s_[3] ^= s_[1];
+        s_[1] ^= s_[2];
+        s_[0] ^= s_[3];
+        s_[2] ^= t;
+        s_[3] = rotl(s_[3], 45);
+        return r;
+    }
+
+    // uniform in [0, n)
+    uint64_t below(uint64_t n) { return (uint64_t)(((unsigned __int128)next() * n) >> 64); }
+
+    // uniform in [0, 1)
+    double unit() { return (double)(next() >> 11) * 0x1.0p-53; }
+
+private:
+    static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+    uint64_t s_[4];
+};
+
+// -------------------- zone distributions --------------------
+// Zipf over ranks 1..n by rejection-inversion (Hormann & Derflinger), so
+// sampling is O(1) and needs no table however large n is.
+class ZipfSampler {
+public:
+    ZipfSampler(uint64_t n, double s) : n_((double)n), s_(s) {
+        hx1_ = hIntegral(1.5) - 1.0;
+        hn_ = hIntegral(n_ + 0.5);
+        cut_ = 2.0 - hInv(hIntegral(2.5) - h(2.0));
+    }
+
+    // rank in [0, n), 0 the most frequent
+    uint64_t sample(Rng& rng) const {
+        for (;;) {
+            double u = hn_ + rng.unit() * (hx1_ - hn_);
+            double x = hInv(u);
+            double k = std::floor(x + 0.5);
+            if (k < 1) k = 1;
+            else if (k > n_) k = n_;
+            if (k - x <= cut_ || u >= hIntegral(k + 0.5) - h(k)) return (uint64_t)k - 1;
+        }
+    }
+
+private:
+    // x^-s, its integral, and the integral's inverse; s = 1 is the log case
+    double h(double x) const { return std::exp(-s_ * std::log(x)); }
+    double hIntegral(double x) const {
+        double e = 1.0 - s_;
+        return std::fabs(e) < 1e-9 ? std::log(x) : std::exp(e * std::log(x)) / e;
+    }
+    double hInv(double x) const {
+        double e = 1.0 - s_;
+        return std::fabs(e) < 1e-9 ? std::exp(x) : std::exp(std::log(e * x) / e);
+    }
+
+    double n_, s_, hx1_, hn_, cut_;
+};
+
+enum class Dist { Zipf, Uniform, Hot };
+
+struct Options {
+    uint64_t rows = 1000000;
+    uint64_t zones = 1000;
+    Dist dist = Dist::Zipf;
+    double param = 1.0; // zipf exponent, or the hot zone's share
+    int columns = 6;
+    double dirty = 0.0;
+    bool kinds[4] = {true, true, true, true};
+    uint64_t seed = 1;
+    bool header = true;
+    const char* out = nullptr;
+};
+
+enum Dirty { kMissing, kBadTime, kQuoted, kCrlf };
+static const char* const kDirtyNames[] = {"missing", "badtime", "quoted", "crlf"};
+
+// -------------------- output --------------------
+// Rows are formatted into a 1 MiB block and written with one fwrite each.
+class Out {
+public:
+    explicit Out(FILE* f) : f_(f) { buf_.resize(1 << 20); }
+    ~Out() { flush(); }
+
+    // room for one row; rows are far shorter than this
+    char* reserve() {
+        if (buf_.size() - used_ < 512) flush();
+        return buf_.data() + used_;
+    }
+    void commit(char* end) { used_ = (size_t)(end - buf_.data()); }
+
+    void flush() {
+        if (used_ && std::fwrite(buf_.data(), 1, used_, f_) != used_) {
+            std::perror("gen_trips: write");
+            std::exit(1);
+        }
+        used_ = 0;
+    }
+
+private:
+    FILE* f_;
+    std::vector<char> buf_;
+    size_t used_ = 0;
+};
+
+static char* putText(char* p, const char* s) {
+    while (*s) *p++ = *s++;
+    return p;
+}
+
+static char* putUint(char* p, uint64_t v) {
+    char tmp[20];
+    int n = 0;
+    do {
+        tmp[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+    while (n) *p++ = tmp[--n];
+    return p;
+}
+
+static char* putPadded(char* p, uint64_t v, int width) {
+    for (int i = width - 1; i >= 0; --i) {
+        p[i] = (char)('0' + v % 10);
+        v /= 10;
+    }
+    return p + width;
+}
+
+// ZONE + zero-padded id, width fixed by the cardinality like SmallTrips.csv
+static char* putZone(char* p, uint64_t id, int width) {
+    p = putText(p, "ZONE");
+    return putPadded(p, id, width);
+}
+
+// "2024-MM-DD HH:MM"
+static char* putTime(char* p, Rng& rng) {
+    uint64_t r = rng.next();
+    p = putText(p, "2024-");
+    p = putPadded(p, 1 + (r % 12), 2);
+    *p++ = '-';
+    p = putPadded(p, 1 + ((r >> 8) % 28), 2);
+    *p++ = ' ';
+    p = putPadded(p, (r >> 16) % 24, 2);
+    *p++ = ':';
+    return putPadded(p, (r >> 24) % 60, 2);
+}
+
+// one-decimal fixed point in [lo, lo + span)
+static char* putDecimal(char* p, Rng& rng, uint64_t lo, uint64_t span) {
+    uint64_t tenths = lo * 10 + rng.below(span * 10);
+    p = putUint(p, tenths / 10);
+    *p++ = '.';
+    *p++ = (char)('0' + tenths % 10);
+    return p;
+}
+
+static const char* const kBadTimes[] = {"2024-01-01 25:00", "2024-01-01", "not-a-time", "2024-01-01 24:00", ""};
+
+// -------------------- generator --------------------
+static int zoneWidth(uint64_t zones) {
+    int w = 3;
+    for (uint64_t cap = 1000; cap < zones && w < 19; cap *= 10) w++;
+    return w;
+}
+
+// Shuffled rank -> zone id, so the popular zones are not also the
+// lexicographically smallest ones. A keyed Feistel network shuffles the
+// smallest power of four covering the zones; a value past the last zone
+// is shuffled again until it lands inside (under four rounds on average,
+// since the domain is less than four times the zones). No table, so
+// memory stays flat at any --zones.
+class ZonePermutation {
+public:
+    ZonePermutation(uint64_t zones, Rng& rng) : zones_(zones) {
+        while (half_ < 32 && (1ull << (2 * half_)) < zones) half_++;
+        mask_ = (1ull << half_) - 1;
+        for (uint64_t& k : keys_) k = rng.next();
+    }
+
+    uint64_t operator()(uint64_t rank) const {
+        do rank = shuffle(rank);
+        while (rank >= zones_);
+        return rank;
+    }
+
+private:
+    uint64_t shuffle(uint64_t x) const {
+        uint64_t l = x >> half_, r = x & mask_;
+        for (uint64_t k : keys_) {
+            uint64_t z = (r ^ k) * 0xBF58476D1CE4E5B9ull;
+            uint64_t f = (z ^ (z >> 31)) & mask_;
+            uint64_t next = l ^ f;
+            l = r;
+            r = next;
+        }
+        return (l << half_) | r;
+    }
+
+    uint64_t zones_;
+    int half_ = 0; // bits per Feistel half
+    uint64_t mask_;
+    uint64_t keys_[4];
+};
+
+static void generate(const Options& o, FILE* f) {
+    Rng rng(o.seed);
+    ZonePermutation perm(o.zones, rng);
+    ZipfSampler zipf(o.zones, o.dist == Dist::Zipf ? o.param : 1.0);
+    int width = zoneWidth(o.zones);
+
+    int kinds[4], nKinds = 0;
+    for (int k = 0; k < 4; ++k)
+        if (o.kinds[k]) kinds[nKinds++] = k;
+
+    Out out(f);
+    if (o.header) {
+        char* p = out.reserve();
+        p = putText(p, o.columns == 3 ? "TripID,PickupZoneID,PickupTime\n"
+                                      : "TripID,PickupZoneID,DropoffZoneID,PickupDateTime,DistanceKm,FareAmount\n");
+        out.commit(p);
+    }
+
+    for (uint64_t i = 0; i < o.rows; ++i) {
+        uint64_t rank;
+        if (o.dist == Dist::Uniform) rank = rng.below(o.zones);
+        else if (o.dist == Dist::Hot) rank = rng.unit() < o.param || o.zones == 1 ? 0 : 1 + rng.below(o.zones - 1);
+        else rank = zipf.sample(rng);
+        uint64_t zone = perm(rank);
+
+        int dirty = -1;
+        if (nKinds && o.dirty > 0 && rng.unit() < o.dirty) dirty = kinds[rng.below((uint64_t)nKinds)];
+
+        char* p = out.reserve();
+        p = putUint(p, 1000001 + i);
+        *p++ = ',';
+        if (dirty == kQuoted) *p++ = '"';
+        p = putZone(p, zone, width);
+        if (dirty == kQuoted) *p++ = '"';
+
+        if (dirty == kMissing) {
+            // cut the row short after the zone: too few fields to count
+            *p++ = '\n';
+            out.commit(p);
+            continue;
+        }
+
+        *p++ = ',';
+        if (o.columns == 6) {
+            p = putZone(p, perm(rng.below(o.zones)), width);
+            *p++ = ',';
+        }
+        if (dirty == kBadTime) p = putText(p, kBadTimes[rng.below(sizeof(kBadTimes) / sizeof(kBadTimes[0]))]);
+        else p = putTime(p, rng);
+        if (o.columns == 6) {
+            *p++ = ',';
+            p = putDecimal(p, rng, 1, 50);
+            *p++ = ',';
+            p = putDecimal(p, rng, 10, 190);
+        }
+        if (dirty == kCrlf) *p++ = '\r';
+        *p++ = '\n';
+        out.commit(p);
+    }
+}
+
+// -------------------- command line --------------------
+static void usage() {
+    std::fprintf(stderr,
+                 "usage: gen_trips [--rows N] [--zones N] [--dist zipf[:s]|uniform|hot[:p]]\n"
+                 "                 [--columns 3|6] [--dirty R] [--dirty-kinds missing,badtime,quoted,crlf]\n"
+                 "                 [--seed N] [--no-header] [-o out.csv]\n");
+    std::exit(2);
+}
+
+static bool parseKinds(const std::string& list, bool kinds[4]) {
+    for (int k = 0; k < 4; ++k) kinds[k] = false;
+    size_t p = 0;
+    while (p <= list.size()) {
+        size_t comma = list.find(',', p);
+        if (comma == std::string::npos) comma = list.size();
+        std::string name = list.substr(p, comma - p);
+        bool known = false;
+        for (int k = 0; k < 4; ++k) {
+            if (name == kDirtyNames[k]) kinds[k] = known = true;
+        }
+        if (!known) return false;
+        p = comma + 1;
+    }
+    return true;
+}
+
+static bool parseDist(const std::string& v, Options& o) {
+    size_t colon = v.find(':');
+    std::string name = v.substr(0, colon);
+    if (name == "zipf") {
+        o.dist = Dist::Zipf;
+        o.param = 1.0;
+    } else if (name == "uniform") {
+        o.dist = Dist::Uniform;
+    } else if (name == "hot") {
+        o.dist = Dist::Hot;
+        o.param = 0.5;
+    } else {
+        return false;
+    }
+    if (colon != std::string::npos) o.param = std::atof(v.c_str() + colon + 1);
+    if (o.dist == Dist::Zipf) return o.param > 0;
+    return o.param >= 0 && o.param <= 1;
+}
+
+int main(int argc, char** argv) {
+    Options o;
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (a == "--no-header") {
+            o.header = false;
+        } else if (!hasValue) {
+            usage();
+        } else if (a == "--rows") {
+            o.rows = std::strtoull(argv[++i], nullptr, 10);
+        } else if (a == "--zones") {
+            o.zones = std::strtoull(argv[++i], nullptr, 10);
+        } else if (a == "--dist") {
+            if (!parseDist(argv[++i], o)) usage();
+        } else if (a == "--columns") {
+            o.columns = std::atoi(argv[++i]);
+        } else if (a == "--dirty") {
+            o.dirty = std::atof(argv[++i]);
+        } else if (a == "--dirty-kinds") {
+            if (!parseKinds(argv[++i], o.kinds)) usage();
+        } else if (a == "--seed") {
+            o.seed = std::strtoull(argv[++i], nullptr, 10);
+        } else if (a == "-o") {
+            o.out = argv[++i];
+        } else {
+            usage();
+        }
+    }
+    if (o.zones < 1 || o.zones > UINT32_MAX || (o.columns != 3 && o.columns != 6) || o.dirty < 0 || o.dirty > 1) usage();
+
+    FILE* f = stdout;
+    if (o.out && std::strcmp(o.out, "-") != 0) {
+        f = std::fopen(o.out, "wb");
+        if (!f) {
+            std::perror(o.out);
+            return 1;
+        }
+    }
+    generate(o, f);
+
+    // buffered bytes are only written here: a full disk shows up in the
+    // flush or the close, not in fwrite
+    bool ok = std::fflush(f) == 0 && !std::ferror(f);
+    if (f != stdout && std::fclose(f) != 0) ok = false;
+    if (!ok) {
+        std::perror(f != stdout ? o.out : "gen_trips: stdout");
+        return 1;
+    }
+    return 0;
+}
@@ -1,6 +1,7 @@
 #include "analyzer.h"
 #include <iostream>
 #include <chrono>
+#include <string>
 
 static void printZones(const std::vector<ZoneCount>& v) {
     std::cout << "TOP_ZONES\n";
@@ -14,11 +15,48 @@ static void printSlots(const std::vector<SlotCount>& v) {
         std::cout << x.zone << "," << x.hour << "," << x.count << "\n";
 }
 
-int main() {
+// Only printed by a stats build (make STATS=1), as is printMemory.
+static void printStats(const IngestStats& s) {
+    std::cout << "STATS\n"
+              << "bytes_read," << s.bytesRead << "\n"
+              << "rows_seen," << s.rowsSeen << "\n"
+              << "rows_accepted," << s.rowsAccepted << "\n"
+              << "rejected_fields," << s.rejectedFields << "\n"
+              << "rejected_empty_zone," << s.rejectedEmptyZone << "\n"
+              << "rejected_bad_time," << s.rejectedBadTime << "\n"
+              << "rejected_hour_range," << s.rejectedHourRange << "\n"
+              << "read_ms," << s.readMs << "\n"
+              << "tokenize_ms," << s.tokenizeMs << "\n"
+              << "hour_ms," << s.hourMs << "\n"
+              << "hash_ms," << s.hashMs << "\n"
+              << "rehash_ms," << s.rehashMs << "\n"
+              << "zones," << s.zones << "\n"
+              << "load_factor," << s.loadFactor << "\n"
+              << "rehashes," << s.rehashes << "\n"
+              << "front_cache_lookups," << s.frontCacheLookups << "\n"
+              << "front_cache_hit_rate," << s.frontCacheHitRate << "\n";
+}
+
+static void printMemory(const MemoryUsage& m) {
+    std::cout << "MEMORY_BYTES\n"
+              << "zone_index," << m.zoneIndex << "\n"
+              << "zone_names," << m.zoneNames << "\n"
+              << "zone_cells," << m.zoneCells << "\n"
+              << "dense_hours," << m.denseHours << "\n"
+              << "snapshot," << m.snapshot << "\n"
+              << "ranking_cache," << m.rankingCache << "\n"
+              << "follow_buffer," << m.followBuffer << "\n"
+              << "total," << m.total() << "\n";
+}
+
+// Usage: app [path | -]   ("-" reads the CSV from stdin)
+int main(int argc, char** argv) {
     auto t0 = std::chrono::high_resolution_clock::now();
 
+    std::string path = argc > 1 ? argv[1] : "SmallTrips.csv";
     TripAnalyzer analyzer;
-    analyzer.ingestFile("SmallTrips.csv");
+    if (path == "-") analyzer.ingestFd(0);
+    else analyzer.ingestFile(path);
 
     printZones(analyzer.topZones(10));
     printSlots(analyzer.topBusySlots(10));
@@ -27,5 +65,11 @@ int main() {
     auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count();
 
     std::cout << "EXEC_MS\n" << ms << "\n";
+
+    IngestStats stats = analyzer.ingestStats();
+    if (stats.enabled) {
+        printStats(stats);
+        printMemory(analyzer.memoryUsage());
+    }
     return 0;
 }
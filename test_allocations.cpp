@@ -0,0 +1,107 @@
+#include "catch_amalgamated.hpp"
+#include "analyzer.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <new>
+#include <string>
+
+// Allocation-counting tests, in a binary of their own: replacing the global
+// allocator here would otherwise apply to every test in `tests`.
+//
+// Every replaceable operator new and operator delete is defined below, so
+// no path mixes these with the library's defaults.
+
+namespace fs = std::filesystem;
+
+// -------------------- counting allocator --------------------
+static std::atomic<long long> g_newCalls{0};
+
+static void* countedAlloc(std::size_t n, std::size_t align) noexcept {
+    ++g_newCalls;
+    if (n == 0) n = 1;
+    if (align <= alignof(std::max_align_t)) return std::malloc(n);
+    void* p = nullptr;
+    return ::posix_memalign(&p, align, n) == 0 ? p : nullptr;
+}
+
+static void* countedNew(std::size_t n, std::size_t align) {
+    if (void* p = countedAlloc(n, align)) return p;
+    throw std::bad_alloc();
+}
+
+static const std::size_t kPlain = alignof(std::max_align_t);
+
+void* operator new(std::size_t n) { return countedNew(n, kPlain); }
+void* operator new[](std::size_t n) { return countedNew(n, kPlain); }
+void* operator new(std::size_t n, std::align_val_t a) { return countedNew(n, (std::size_t)a); }
+void* operator new[](std::size_t n, std::align_val_t a) { return countedNew(n, (std::size_t)a); }
+void* operator new(std::size_t n, const std::nothrow_t&) noexcept { return countedAlloc(n, kPlain); }
+void* operator new[](std::size_t n, const std::nothrow_t&) noexcept { return countedAlloc(n, kPlain); }
+void* operator new(std::size_t n, std::align_val_t a, const std::nothrow_t&) noexcept {
+    return countedAlloc(n, (std::size_t)a);
+}
+void* operator new[](std::size_t n, std::align_val_t a, const std::nothrow_t&) noexcept {
+    return countedAlloc(n, (std::size_t)a);
+}
+
+// malloc and posix_memalign memory are both released with free
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { std::free(p); }
+
+// -------------------- helpers --------------------
+static std::string zpad(int n, int width) {
+    std::string s = std::to_string(n);
+    if ((int)s.size() >= width) return s;
+    return std::string(width - (int)s.size(), '0') + s;
+}
+
+static long long allocationsToIngest(const fs::path& csvPath, int rows) {
+    std::string csv = "TripID,PickupZoneID,DropoffZoneID,PickupDateTime,DistanceKm,Fare\n";
+    for (int i = 0; i < rows; i++) {
+        csv += std::to_string(i + 1);
+        csv += (i % 10 == 0) ? ",\"Z" : ",Z"; // every tenth zone is quoted
+        csv += std::to_string(i & 3);
+        csv += (i % 10 == 0) ? "\"" : "";
+        csv += ",Z9,2024-01-01 ";
+        csv += zpad(i % 24, 2);
+        csv += ":00,1.0,5.0\n";
+    }
+    std::ofstream out(csvPath, std::ios::binary);
+    out << csv;
+    out.close();
+
+    TripAnalyzer a;
+    long long before = g_newCalls.load();
+    a.ingestFile(csvPath.string());
+    long long after = g_newCalls.load();
+    REQUIRE(a.topZones(1).size() == 1);
+    return after - before;
+}
+
+// -------------------- tests --------------------
+TEST_CASE("D3 steady-state ingest makes no per-row allocations", "[D]") {
+    fs::path csv = fs::temp_directory_path() /
+                   ("cmp2003_alloc_" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()) +
+                    ".csv");
+    long long small = allocationsToIngest(csv, 20000);
+    long long large = allocationsToIngest(csv, 80000);
+    std::error_code ec;
+    fs::remove(csv, ec);
+    INFO("allocations small=" << small << " large=" << large);
+    REQUIRE(large <= small); // 4x the rows, no extra allocations
+}
@@ -1,5 +1,8 @@
 #include "catch_amalgamated.hpp"
 #include "analyzer.h"
+#include "csv_tokenizer.h"
+#include "trip_fields.h"
+#include "zone_index.h"
 
 #include <filesystem>
 #include <fstream>
@@ -7,7 +10,15 @@
 #include <vector>
 #include <tuple>
 #include <cstdlib>
+#include <cstring>
 #include <chrono>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <map>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
 
 namespace fs = std::filesystem;
 
@@ -31,6 +42,33 @@ static bool fastMode() {
     return e && std::string(e) == "1";
 }
 
+using ZoneList = std::vector<std::pair<std::string, long long>>;
+using SlotList = std::vector<std::tuple<std::string, int, long long>>;
+
+// Reference rankings: a full sort of the expected counts (any container of
+// (zone, count) pairs or (zone, hour, count) tuples), cut to the top k.
+template <class Counts>
+static ZoneList expectedTopZones(const Counts& counts, size_t k = SIZE_MAX) {
+    ZoneList all(counts.begin(), counts.end());
+    std::sort(all.begin(), all.end(), [](const auto& a, const auto& b) {
+        return a.second != b.second ? a.second > b.second : a.first < b.first;
+    });
+    all.resize(std::min(k, all.size()));
+    return all;
+}
+
+template <class Counts>
+static SlotList expectedTopSlots(const Counts& counts, size_t k = SIZE_MAX) {
+    SlotList all(counts.begin(), counts.end());
+    std::sort(all.begin(), all.end(), [](const auto& a, const auto& b) {
+        if (std::get<2>(a) != std::get<2>(b)) return std::get<2>(a) > std::get<2>(b);
+        if (std::get<0>(a) != std::get<0>(b)) return std::get<0>(a) < std::get<0>(b);
+        return std::get<1>(a) < std::get<1>(b);
+    });
+    all.resize(std::min(k, all.size()));
+    return all;
+}
+
 static void requireZonesEq(const std::vector<ZoneCount>& got,
                            const std::vector<std::pair<std::string, long long>>& exp) {
     REQUIRE(got.size() == exp.size());
@@ -322,3 +360,1136 @@ TEST_CASE_METHOD(TripsFixture,
     const long long limit = envMs("C3_LIMIT_MS", fastMode() ? 3500 : 9000);
     REQUIRE(ms < limit);
 }
+
+// =============================================================
+// CATEGORY D (ungraded): extended ingest API
+// These pin down behaviour of the options beyond the grading skeleton.
+// =============================================================
+static void requireSameResults(const TripAnalyzer& a, const TripAnalyzer& b, int k = 1000) {
+    auto za = a.topZones(k), zb = b.topZones(k);
+    REQUIRE(za.size() == zb.size());
+    for (size_t i = 0; i < za.size(); i++) {
+        INFO("Zone index " << i);
+        REQUIRE(za[i].zone == zb[i].zone);
+        REQUIRE(za[i].count == zb[i].count);
+    }
+    auto sa = a.topBusySlots(k), sb = b.topBusySlots(k);
+    REQUIRE(sa.size() == sb.size());
+    for (size_t i = 0; i < sa.size(); i++) {
+        INFO("Slot index " << i);
+        REQUIRE(sa[i].zone == sb[i].zone);
+        REQUIRE(sa[i].hour == sb[i].hour);
+        REQUIRE(sa[i].count == sb[i].count);
+    }
+}
+
+// 6-column rows with the usual dirt: CRLF, quotes, short rows, no final newline
+static const char* kDirtyWideCsv =
+    "TripID,PickupZoneID,DropoffZoneID,PickupDateTime,DistanceKm,Fare\r\n"
+    "1,ZONE_A,ZONE_B,2024-01-01 10:30,1.0,5.0\r\n"
+    "2,\"ZONE_A\",ZONE_C,2024-01-01 10:45,1.0,5.0\n"
+    "3,\"ZO,NE\",ZONE_C,2024-01-01 11:05,1.0,5.0\n"
+    "4,\"Z\"\"Q\",ZONE_C,2024-01-01 23:59,1.0,5.0\n"
+    "5,ZONE_B,ZONE_C,NOT_A_TIME,1.0,5.0\n"
+    "6,,ZONE_C,2024-01-01 11:00,1.0,5.0\n"
+    "7,ZONE_B,ZONE_C,2024-01-01 00:10,1.0\n"
+    "\n"
+    "8,zone_b,ZONE_C,2024-01-01 00:10,1.0,5.0\n"
+    "9,ZONE_B,ZONE_C,2024-01-01 07:00,1.0,5.0";
+
+TEST_CASE_METHOD(TripsFixture, "D1 mmap ingest matches stream ingest", "[D]") {
+    writeTripsCsv(kDirtyWideCsv);
+
+    IngestOptions streamed;
+    streamed.useMmap = false;
+
+    TripAnalyzer mapped, stream;
+    REQUIRE_NOTHROW(mapped.ingestFile("Trips.csv"));
+    REQUIRE_NOTHROW(stream.ingestFile("Trips.csv", streamed));
+
+    requireZonesEq(mapped.topZones(3), {{"ZONE_A", 2}, {"ZONE_B", 2}, {"Z\"Q", 1}});
+    requireSameResults(mapped, stream);
+
+    // a missing file is still just an empty result
+    TripAnalyzer missing;
+    REQUIRE_NOTHROW(missing.ingestFile("NoSuchTrips.csv"));
+    REQUIRE(missing.topZones(10).empty());
+}
+
+TEST_CASE_METHOD(TripsFixture, "D2 parallel ingest matches serial ingest", "[D]") {
+    // large enough that every worker gets a range of its own
+    const int N = 200000;
+    std::string csv = "TripID,PickupZoneID,DropoffZoneID,PickupDateTime,DistanceKm,Fare\n";
+    csv.reserve((size_t)N * 48);
+    for (int i = 0; i < N; i++) {
+        csv += std::to_string(i + 1);
+        csv += ",Z";
+        csv += std::to_string((i * 7919) % 1000);
+        csv += ",Z0,2024-01-01 ";
+        csv += zpad(i % 24, 2);
+        csv += (i % 97 == 0) ? ":00,1.0\n" : ":00,1.0,5.0\r\n"; // sprinkle short rows
+    }
+    writeTripsCsv(csv);
+
+    IngestOptions parallel;
+    parallel.threads = 4;
+
+    TripAnalyzer serial, threaded;
+    serial.ingestFile("Trips.csv");
+    threaded.ingestFile("Trips.csv", parallel);
+
+    REQUIRE(serial.topZones(1).size() == 1);
+    requireSameResults(serial, threaded);
+}
+
+TEST_CASE_METHOD(TripsFixture, "D4 SIMD scanner matches the line tokenizer", "[D]") {
+    // quotes spanning 64-byte blocks, unterminated quotes, CRLF, empty lines
+    std::string buf = kDirtyWideCsv;
+    buf += "\n\"open quote runs to the end of the line,a,b\r\n"
+           "x,\"\",\"\"\"\",\n"
+           ",\n\r\n\"\"\n";
+    buf += std::string(70, 'q') + ",\"" + std::string(80, ',') + "\",tail\n";
+    buf += "last,\"unterminated";
+
+    std::vector<std::vector<std::string>> expected;
+    CsvTokenizer tok;
+    std::string line;
+    std::istringstream in(buf);
+    while (std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty()) continue;
+        tok.split(line);
+        expected.emplace_back(); // a row even with no fields, like `""`
+        for (size_t i = 0; i < tok.size(); i++) expected.back().emplace_back(tok[i]);
+    }
+
+    for (CsvIsa isa : {CsvIsa::Scalar, CsvIsa::Sse2, CsvIsa::Avx2}) {
+        CsvScanner scanner(isa);
+        INFO("isa " << (int)scanner.isa());
+        std::vector<std::vector<std::string>> got;
+        scanner.scan(buf.data(), buf.size(), [&](const std::string_view* f, size_t n) {
+            got.emplace_back(f, f + n);
+        });
+        REQUIRE(got == expected);
+    }
+
+    writeTripsCsv(kDirtyWideCsv);
+    IngestOptions simd;
+    simd.engine = CsvEngine::Simd;
+
+    TripAnalyzer lines, scanned;
+    lines.ingestFile("Trips.csv");
+    scanned.ingestFile("Trips.csv", simd);
+    requireSameResults(lines, scanned);
+}
+
+TEST_CASE_METHOD(TripsFixture, "D5 header names decide which columns are read", "[D]") {
+    // reordered columns; a row must still have as many fields as the header
+    writeTripsCsv(
+        "pickuptime , TripID,Fare,PickupZoneID\r\n"
+        "2024-01-01 09:15,1,5.0,Z1\r\n"
+        "2024-01-01 09:45,2,5.0,Z1,extra\r\n"
+        "2024-01-01 10:00,3,Z2\r\n"
+        "2024-01-01 10:00,4,,Z2\r\n");
+
+    for (CsvEngine engine : {CsvEngine::Lines, CsvEngine::Simd}) {
+        IngestOptions opts;
+        opts.engine = engine;
+        TripAnalyzer a;
+        a.ingestFile("Trips.csv", opts);
+        requireZonesEq(a.topZones(10), {{"Z1", 2}, {"Z2", 1}});
+        requireSlotsEq(a.topBusySlots(10), {{"Z1", 9, 2}, {"Z2", 10, 1}});
+    }
+}
+
+TEST_CASE_METHOD(TripsFixture, "D6 independent analyzers share no state", "[D]") {
+    std::ofstream("A.csv") << "TripID,PickupZoneID,PickupTime\n1,ZA,2024-01-01 01:00\n";
+    std::ofstream("B.csv") << "TripID,PickupZoneID,PickupTime\n1,ZB,2024-01-01 02:00\n2,ZB,2024-01-01 02:30\n";
+
+    // ingest and query concurrently; each analyzer must only see its own file
+    std::vector<TripAnalyzer> analyzers(8);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < analyzers.size(); i++) {
+        threads.emplace_back([&analyzers, i] {
+            for (int rep = 0; rep < 50; rep++) analyzers[i].ingestFile(i % 2 ? "B.csv" : "A.csv");
+        });
+    }
+    for (auto& t : threads) t.join();
+
+    for (size_t i = 0; i < analyzers.size(); i++) {
+        if (i % 2) requireZonesEq(analyzers[i].topZones(10), {{"ZB", 2}});
+        else requireZonesEq(analyzers[i].topZones(10), {{"ZA", 1}});
+    }
+
+    // moving hands the aggregates over; the moved-from analyzer is empty but usable
+    TripAnalyzer moved = std::move(analyzers[1]);
+    requireSlotsEq(moved.topBusySlots(10), {{"ZB", 2, 2}});
+    REQUIRE(analyzers[1].topZones(10).empty());
+    analyzers[1].ingestFile("A.csv");
+    requireZonesEq(analyzers[1].topZones(10), {{"ZA", 1}});
+}
+
+TEST_CASE("D7 zone index agrees with unordered_map", "[D]") {
+    ZoneIndex index;
+    std::unordered_map<std::string, uint32_t> ref;
+
+    // short keys, 23-byte keys and long keys
+    for (int i = 0; i < 20000; i++) {
+        std::string key = "Z" + std::to_string(i * 7919 % 5000);
+        if (i % 3 == 1) key += std::string(23 - key.size(), 'X');
+        if (i % 5 == 2) key += std::string(40, 'L');
+        auto it = ref.emplace(key, (uint32_t)ref.size()).first;
+        REQUIRE(index.intern(key) == it->second);
+    }
+    REQUIRE(index.size() == ref.size());
+    for (const auto& kv : ref) {
+        REQUIRE(index.find(kv.first) == kv.second);
+        REQUIRE(index.name(kv.second) == kv.first);
+    }
+    REQUIRE(index.find("missing") == ZoneIndex::kNotFound);
+    REQUIRE(index.find("") == ZoneIndex::kNotFound);
+
+    // at the growth threshold, looking up known keys must not rehash
+    while (!index.needsGrow()) index.intern("F" + std::to_string(index.size()));
+    size_t cap = index.capacity(), rehashes = index.rehashes();
+    for (const auto& kv : ref) REQUIRE(index.intern(kv.first) == kv.second);
+    REQUIRE(index.capacity() == cap);
+    REQUIRE(index.rehashes() == rehashes);
+    uint32_t next = index.size();
+    REQUIRE(index.intern("one more") == next);
+    REQUIRE(index.capacity() == cap * 2);
+
+    index.clear();
+    REQUIRE(index.size() == 0);
+    REQUIRE(index.intern("A") == 0);
+}
+
+TEST_CASE_METHOD(TripsFixture, "D8 bounded top-k matches a full sort", "[D]") {
+    // few distinct counts over many zones, so most of the ranking is tie-breaks
+    ZoneList all;
+    std::ofstream out("Trips.csv");
+    out << "TripID,PickupZoneID,DropoffZoneID,PickupDateTime,DistanceKm,Fare\n";
+    int id = 0;
+    for (int z = 0; z < 300; z++) {
+        std::string zone = "Z" + std::to_string(z * 37 % 300);
+        long long n = 1 + z % 4;
+        for (long long i = 0; i < n; i++) out << ++id << "," << zone << ",Z9,2024-01-01 10:00,1,5\n";
+        all.push_back({zone, n});
+    }
+    out.close();
+
+    TripAnalyzer a;
+    a.ingestFile("Trips.csv");
+    for (int k : {1, 2, 7, 75, 76, 299, 300, 1000}) requireZonesEq(a.topZones(k), expectedTopZones(all, k));
+}
+
+TEST_CASE_METHOD(TripsFixture, "D9 bounded slot top-k matches a full sort", "[D]") {
+    // repeat counts across zones and hours so all three sort keys matter
+    SlotList all;
+    std::ofstream out("Trips.csv");
+    out << "TripID,PickupZoneID,DropoffZoneID,PickupDateTime,DistanceKm,Fare\n";
+    int id = 0;
+    for (int z = 0; z < 40; z++) {
+        std::string zone = "Z" + std::to_string(z * 7 % 40);
+        for (int h = z % 3; h < 24; h += 2) {
+            long long n = 1 + (z + h) % 3;
+            for (long long i = 0; i < n; i++) {
+                out << ++id << "," << zone << ",Z9,2024-01-01 " << zpad(h, 2) << ":15,1,5\n";
+            }
+            all.emplace_back(zone, h, n);
+        }
+    }
+    out.close();
+
+    TripAnalyzer a;
+    a.ingestFile("Trips.csv");
+    for (int k : {1, 10, 99, 400, 100000}) requireSlotsEq(a.topBusySlots(k), expectedTopSlots(all, k));
+}
+
+TEST_CASE_METHOD(TripsFixture, "D10 cached rankings match uncached and follow ingests", "[D]") {
+    std::ofstream out("Trips.csv");
+    out << "TripID,PickupZoneID,DropoffZoneID,PickupDateTime,DistanceKm,Fare\n";
+    for (int i = 0; i < 3000; i++) {
+        out << i << ",Z" << (i * i) % 97 << ",Z9,2024-01-01 " << zpad(i % 24, 2) << ":00,1,5\n";
+    }
+    out.close();
+    std::ofstream("Small.csv") << "TripID,PickupZoneID,PickupTime\n1,ZA,2024-01-01 01:00\n";
+
+    TripAnalyzer cached, plain;
+    plain.setRankingCache(false);
+    cached.ingestFile("Trips.csv");
+    plain.ingestFile("Trips.csv");
+    REQUIRE(cached.rankingCacheBytes() == 0);
+
+    for (int k : {3, 50, 5, 200, 1, 2000, 10}) {
+        INFO("k=" << k);
+        requireSameResults(cached, plain, k);
+    }
+    REQUIRE(cached.rankingCacheBytes() > 0);
+    REQUIRE(plain.rankingCacheBytes() == 0);
+
+    // a new ingest must not be answered from the old ranking
+    cached.ingestFile("Small.csv");
+    REQUIRE(cached.rankingCacheBytes() == 0);
+    requireZonesEq(cached.topZones(10), {{"ZA", 1}});
+
+    cached.setRankingCache(false);
+    REQUIRE(cached.rankingCacheBytes() == 0);
+    requireSlotsEq(cached.topBusySlots(10), {{"ZA", 1, 1}});
+}
+
+TEST_CASE_METHOD(TripsFixture, "D11 packed ranking keys keep name order", "[D]") {
+    // names that tie on their first 8 bytes, prefixes of each other and bytes above 0x7F
+    const char* const names[] = {"ZONE-ALPHA-2", "ZONE-ALPHA-10", "ZONE-ALPHA", "ZONE-ALP",
+                                 "ZONE-AL", "Z\xC3\x89TA", "ZETA", "Z~", "Z0", "A"};
+    ZoneList all;
+    std::ofstream out("Trips.csv");
+    out << "TripID,PickupZoneID,DropoffZoneID,PickupDateTime,DistanceKm,Fare\n";
+    int id = 0;
+    for (int rep = 0; rep < 30; rep++) {
+        for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+            std::string zone = names[i] + (rep ? "#" + std::to_string(rep) : "");
+            long long n = 1 + (rep + i) % 2;
+            for (long long j = 0; j < n; j++) out << ++id << "," << zone << ",Z9,2024-01-01 03:00,1,5\n";
+            all.emplace_back(zone, n);
+        }
+    }
+    out.close();
+
+    // shallow queries rank with the comparator, deep ones with packed keys
+    for (bool cache : {true, false}) {
+        TripAnalyzer a;
+        a.setRankingCache(cache);
+        a.ingestFile("Trips.csv");
+        for (int k : {3, 300, 5}) {
+            ZoneList want = expectedTopZones(all, k);
+            requireZonesEq(a.topZones(k), want);
+            auto slots = a.topBusySlots(k);
+            REQUIRE(slots.size() == want.size());
+            for (size_t i = 0; i < want.size(); i++) {
+                REQUIRE(slots[i].zone == want[i].first);
+                REQUIRE(slots[i].hour == 3);
+            }
+        }
+    }
+}
+
+TEST_CASE_METHOD(TripsFixture, "D12 append and mergeFrom match one combined ingest", "[D]") {
+    std::ofstream all("All.csv");
+    all << "TripID,PickupZoneID,DropoffZoneID,PickupDateTime,DistanceKm,Fare\n";
+    std::vector<std::string> days;
+    for (int d = 0; d < 3; d++) {
+        days.push_back("Day" + std::to_string(d) + ".csv");
+        std::ofstream day(days.back());
+        day << "TripID,PickupZoneID,DropoffZoneID,PickupDateTime,DistanceKm,Fare\n";
+        for (int i = 0; i < 500; i++) {
+            std::ostringstream row;
+            row << i << ",Z" << (i * (d + 3)) % (40 + d * 20) << ",Z9,2024-01-0" << d + 1 << " "
+                << zpad((i + d) % 24, 2) << ":10,1,5\n";
+            day << row.str();
+            all << row.str();
+        }
+    }
+    all.close();
+
+    TripAnalyzer combined;
+    combined.ingestFile("All.csv");
+
+    IngestOptions append;
+    append.append = true;
+    TripAnalyzer appended, merged;
+    for (const auto& day : days) {
+        appended.ingestFile(day, append);
+        appended.topZones(3); // a cached ranking must not survive the next append
+        TripAnalyzer part;
+        part.ingestFile(day);
+        merged.mergeFrom(part);
+    }
+    requireSameResults(appended, combined);
+    requireSameResults(merged, combined);
+
+    // folding an analyzer into itself doubles every count
+    TripAnalyzer doubled;
+    doubled.ingestFile("All.csv");
+    doubled.mergeFrom(doubled);
+    ZoneList twice;
+    for (const auto& z : combined.topZones(5)) twice.push_back({z.zone, 2 * z.count});
+    requireZonesEq(doubled.topZones(5), twice);
+}
+
+TEST_CASE_METHOD(TripsFixture, "D13 multi-file ingest matches appending the files in order", "[D]") {
+    // one file big enough to be split across workers, several small ones
+    fs::create_directories("day");
+    std::ofstream("day/00.csv", std::ios::binary) << kDirtyWideCsv;
+    {
+        std::ofstream big("day/01.csv", std::ios::binary);
+        big << "\r\n\nTripID,PickupZoneID,DropoffZoneID,PickupDateTime,DistanceKm,Fare\n";
+        for (int i = 0; i < 120000; i++) {
+            big << i << ",Z" << (i * 7919) % 3000 << ",Z0,2024-01-01 " << zpad(i % 24, 2) << ":00,1.0,5.0\n";
+        }
+    }
+    for (int f = 2; f < 6; f++) {
+        std::ofstream small("day/0" + std::to_string(f) + ".csv", std::ios::binary);
+        small << "TripID,PickupZoneID,PickupTime\n";
+        for (int i = 0; i < 50 * f; i++) small << i << ",Z" << i % (f * 3) << ",2024-01-01 0" << f << ":00\n";
+    }
+    std::ofstream("day/notes.txt") << "1,ZX,2024-01-01 01:00\n";
+
+    IngestOptions append;
+    append.append = true;
+    TripAnalyzer sequential;
+    for (int f = 0; f < 6; f++) sequential.ingestFile("day/0" + std::to_string(f) + ".csv", append);
+    REQUIRE(sequential.topZones(1).size() == 1);
+
+    for (unsigned threads : {1u, 4u, 0u}) {
+        for (CsvEngine engine : {CsvEngine::Lines, CsvEngine::Simd}) {
+            IngestOptions opts;
+            opts.threads = threads;
+            opts.engine = engine;
+            TripAnalyzer many;
+            many.ingestFiles({"day/*.csv", "day/missing.csv"}, opts);
+            requireSameResults(many, sequential);
+        }
+    }
+
+    // without mmap the files are read in blocks, still split into ranges
+    for (bool async : {false, true}) {
+        for (size_t blockBytes : {size_t(0), size_t(4099)}) {
+            IngestOptions streamed;
+            streamed.useMmap = false;
+            streamed.asyncRead = async;
+            streamed.readBlockBytes = blockBytes;
+            streamed.threads = 3;
+            TripAnalyzer many;
+            many.ingestFiles({"day/00.csv", "day/01.csv", "day/02.csv", "day/03.csv", "day/04.csv", "day/05.csv"},
+                             streamed);
+            requireSameResults(many, sequential);
+        }
+    }
+
+    // a file whose name looks like a pattern is read as itself; a pattern
+    // that only matches other files still expands
+    std::ofstream("day/trips[1].csv") << "TripID,PickupZoneID,PickupTime\n1,LITERAL,2024-01-01 01:00\n";
+    std::ofstream("day/trips1.csv") << "TripID,PickupZoneID,PickupTime\n1,GLOBBED,2024-01-01 01:00\n";
+    TripAnalyzer literal, globbed;
+    literal.ingestFiles({"day/trips[1].csv"});
+    requireZonesEq(literal.topZones(10), {{"LITERAL", 1}});
+    globbed.ingestFiles({"day/trips[1]*.csv"});
+    requireZonesEq(globbed.topZones(10), {{"GLOBBED", 1}});
+}
+
+// The snapshot format's checksum, for forging files that pass it.
+static uint64_t snapshotChecksum(const std::string& bytes) {
+    const size_t kHeader = 64;
+    uint64_t h = 0xCBF29CE484222325ull;
+    for (size_t off = kHeader; off + 8 <= bytes.size(); off += 8) {
+        uint64_t w;
+        std::memcpy(&w, bytes.data() + off, 8);
+        h = (h ^ w) * 0x100000001B3ull;
+        h ^= h >> 29;
+    }
+    return h;
+}
+
+static void resealSnapshot(std::string& bytes) {
+    uint64_t sum = snapshotChecksum(bytes);
+    std::memcpy(&bytes[40], &sum, 8); // header: magic, version, order, counts, then the checksum
+}
+
+TEST_CASE_METHOD(TripsFixture, "D14 snapshots round-trip and reject damaged files", "[D]") {
+    writeTripsCsv(kDirtyWideCsv);
+    std::ofstream("More.csv") << "TripID,PickupZoneID,PickupTime\n1,ZONE_B,2024-01-01 07:30\n2,NEW,2024-01-01 08:00\n";
+
+    TripAnalyzer source;
+    source.ingestFile("Trips.csv");
+    REQUIRE(source.saveSnapshot("trips.snap"));
+
+    TripAnalyzer loaded;
+    REQUIRE(loaded.loadSnapshot("trips.snap"));
+    requireSameResults(loaded, source);
+
+    // writes after a load land on top of the snapshot's counts
+    IngestOptions append;
+    append.append = true;
+    source.ingestFile("More.csv", append);
+    loaded.ingestFile("More.csv", append);
+    requireSameResults(loaded, source);
+
+    // an analyzer serving a mapped snapshot can itself be saved and merged
+    TripAnalyzer reloaded, merged;
+    REQUIRE(loaded.saveSnapshot("again.snap"));
+    REQUIRE(reloaded.loadSnapshot("again.snap"));
+    merged.mergeFrom(reloaded);
+    requireSameResults(merged, source);
+
+    TripAnalyzer empty, emptyLoaded;
+    REQUIRE(empty.saveSnapshot("empty.snap"));
+    REQUIRE(emptyLoaded.loadSnapshot("empty.snap"));
+    REQUIRE(emptyLoaded.topZones(10).empty());
+
+    std::string bytes;
+    {
+        std::ifstream in("trips.snap", std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    std::string flipped = bytes;
+    flipped[bytes.size() / 2] ^= 0x10;
+    std::ofstream("flipped.snap", std::ios::binary) << flipped;
+    std::ofstream("short.snap", std::ios::binary) << bytes.substr(0, bytes.size() - 8);
+    std::ofstream("text.snap", std::ios::binary) << kDirtyWideCsv;
+
+    // forged files with a valid checksum. AA has one inline pair, BB (four
+    // hours of 2^32 trips) a 64-bit row: cells at 64 and 88 (total, 3
+    // counts, 3 hours, used), BB's row at 112, one int64 per hour.
+    const long long c = 1LL << 32;
+    writeTripsCsv("TripID,PickupZoneID,PickupTime\n2,BB,2024-01-01 02:00\n"
+                  "3,BB,2024-01-01 03:00\n4,BB,2024-01-01 04:00\n5,BB,2024-01-01 05:00\n");
+    TripAnalyzer bb;
+    bb.ingestFile("Trips.csv");
+    for (int i = 0; i < 32; i++) bb.mergeFrom(bb);
+    writeTripsCsv("TripID,PickupZoneID,PickupTime\n1,AA,2024-01-01 01:00\n");
+    TripAnalyzer pair;
+    pair.ingestFile("Trips.csv");
+    pair.mergeFrom(bb);
+    REQUIRE(pair.saveSnapshot("pair.snap"));
+    std::string forged;
+    {
+        std::ifstream in("pair.snap", std::ios::binary);
+        forged.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    REQUIRE(forged.size() == 64 + 2 * 24 + 24 * 8 + 16 + 8);
+    auto forge = [&](const char* path, std::initializer_list<std::pair<size_t, long long>> words,
+                     std::initializer_list<std::pair<size_t, uint32_t>> halves) {
+        std::string bytes = forged;
+        for (const auto& w : words) std::memcpy(&bytes[w.first], &w.second, 8);
+        for (const auto& w : halves) std::memcpy(&bytes[w.first], &w.second, 4);
+        resealSnapshot(bytes);
+        std::ofstream(path, std::ios::binary) << bytes;
+    };
+    // a consistent recount loads; totals that are not the sum of their
+    // hours, negative counts and impossible hours do not
+    forge("recounted.snap", {{64, 7}}, {{72, 7}});
+    forge("mismatch.snap", {{64, 7}}, {});
+    forge("negative.snap", {{88, 3 * c - 1}, {112 + 2 * 8, -1}}, {});
+    forge("badhour.snap", {}, {{84, 0x01000000u | 24u}}); // hour[0] = 24, used = 1
+    TripAnalyzer check;
+    REQUIRE(check.loadSnapshot("recounted.snap"));
+    requireZonesEq(check.topZones(10), {{"BB", 4 * c}, {"AA", 7}});
+
+    size_t names = forged.find("AABB");
+    REQUIRE(names != std::string::npos);
+    forged.replace(names, 4, "AAAA");
+    resealSnapshot(forged);
+    std::ofstream("duplicate.snap", std::ios::binary) << forged;
+    TripAnalyzer twice;
+    REQUIRE(twice.loadSnapshot("duplicate.snap"));
+    writeTripsCsv("TripID,PickupZoneID,PickupTime\n1,CC,2024-01-01 03:00\n");
+    twice.ingestFile("Trips.csv", append);
+    requireZonesEq(twice.topZones(10), {{"AA", 4 * c + 1}, {"CC", 1}});
+    requireSlotsEq(twice.topBusySlots(10), {{"AA", 2, c}, {"AA", 3, c}, {"AA", 4, c}, {"AA", 5, c}, {"AA", 1, 1}, {"CC", 3, 1}});
+
+    // failed loads leave the current aggregates alone
+    for (const char* bad : {"flipped.snap", "short.snap", "text.snap", "missing.snap", "mismatch.snap",
+                            "negative.snap", "badhour.snap"}) {
+        INFO(bad);
+        REQUIRE_FALSE(loaded.loadSnapshot(bad));
+        requireSameResults(loaded, source);
+    }
+}
+
+TEST_CASE_METHOD(TripsFixture, "D15 follow mode reads appended lines, truncation and rotation", "[D]") {
+    auto append = [](const char* path, const std::string& text) {
+        std::ofstream(path, std::ios::binary | std::ios::app) << text;
+    };
+
+    TripAnalyzer a;
+    REQUIRE(a.pollFile("feed.csv") == 0); // not there yet
+
+    append("feed.csv", "TripID,PickupZoneID,PickupTime\n1,ZA,2024-01-01 01:00\n2,ZB,2024-01-01 02");
+    REQUIRE(a.pollFile("feed.csv") > 0);
+    requireZonesEq(a.topZones(10), {{"ZA", 1}}); // ZB's line is still incomplete
+
+    append("feed.csv", ":00\r\n3,ZA,2024-01-01 01:30\n");
+    a.pollFile("feed.csv");
+    requireZonesEq(a.topZones(10), {{"ZA", 2}, {"ZB", 1}});
+    REQUIRE(a.pollFile("feed.csv") == 0);
+
+    // copytruncate: the file starts over with a new header
+    std::ofstream("feed.csv", std::ios::binary | std::ios::trunc) << "TripID,PickupZoneID,PickupTime\n4,ZC,2024-01-01 05:00\n";
+    a.pollFile("feed.csv");
+    requireZonesEq(a.topZones(10), {{"ZA", 2}, {"ZB", 1}, {"ZC", 1}});
+
+    // rename rotation: the old file's unterminated tail still counts
+    append("feed.csv", "5,ZC,2024-01-01 05:10");
+    fs::rename("feed.csv", "feed.csv.1");
+    append("feed.csv", "TripID,PickupZoneID,PickupTime\n6,ZD,2024-01-01 06:00\n");
+    a.pollFile("feed.csv");
+    requireZonesEq(a.topZones(10), {{"ZA", 2}, {"ZC", 2}, {"ZB", 1}, {"ZD", 1}});
+    requireSlotsEq(a.topBusySlots(2), {{"ZA", 1, 2}, {"ZC", 5, 2}});
+
+    // replacing the counts forgets the followed file: polling after a
+    // reload is a first poll, as on an analyzer that never followed it
+    append("log.csv", "TripID,PickupZoneID,PickupTime\n1,ZA,2024-01-01 01:00\n");
+    TripAnalyzer fresh;
+    REQUIRE(fresh.saveSnapshot("fresh.snap"));
+    TripAnalyzer b;
+    b.pollFile("log.csv");
+    append("log.csv", "2,ZB,2024-01-01 02:00\n");
+    b.ingestFile("log.csv");
+    b.pollFile("log.csv");
+    TripAnalyzer once;
+    once.ingestFile("log.csv");
+    once.pollFile("log.csv");
+    requireSameResults(b, once);
+    requireZonesEq(b.topZones(10), {{"ZA", 2}, {"ZB", 2}});
+
+    b.pollFile("log.csv");
+    append("log.csv", "3,ZC,2024-01-01 03:00\n");
+    REQUIRE(b.loadSnapshot("fresh.snap"));
+    b.pollFile("log.csv");
+    requireZonesEq(b.topZones(10), {{"ZA", 1}, {"ZB", 1}, {"ZC", 1}});
+}
+
+TEST_CASE_METHOD(TripsFixture, "D16 async reader matches the mapped reader across buffer edges", "[D]") {
+    // several reader buffers' worth, with line lengths that drift against the
+    // buffer size so lines (and CRLF pairs) get cut at every possible offset
+    std::string csv = "\n\nTripID,PickupZoneID,DropoffZoneID,PickupDateTime,DistanceKm,Fare\r\n";
+    csv.reserve(10u << 20);
+    for (int i = 0; csv.size() < (10u << 20); i++) {
+        csv += std::to_string(i);
+        csv += (i % 5 == 0) ? ",\"Z" + std::to_string(i % 700) + "\"" : ",Z" + std::to_string(i % 700);
+        csv += "," + std::string(i % 37, 'D') + ",2024-01-01 " + zpad(i % 24, 2) + ":00,1.0,5.0";
+        csv += (i % 3 == 0) ? "\r\n" : "\n";
+        if (i % 1000 == 0) csv += "\n";
+    }
+    csv += "999999,ZLAST,Z0,2024-01-01 23:00,1.0,5.0"; // no final newline
+    writeTripsCsv(csv);
+
+    TripAnalyzer mapped;
+    mapped.ingestFile("Trips.csv");
+    REQUIRE(mapped.topZones(1).size() == 1);
+
+    for (CsvEngine engine : {CsvEngine::Lines, CsvEngine::Simd}) {
+        IngestOptions opts;
+        opts.useMmap = false;
+        opts.asyncRead = true;
+        opts.engine = engine;
+        TripAnalyzer async;
+        async.ingestFile("Trips.csv", opts);
+        requireSameResults(async, mapped);
+    }
+}
+
+TEST_CASE_METHOD(TripsFixture, "D17 pipes and istreams share the file ingest path", "[D]") {
+    // a little over one 4 MiB read block, so a line straddles the edge
+    std::string csv = kDirtyWideCsv;
+    csv += "\n";
+    for (int i = 0; csv.size() < (5u << 20); i++) {
+        csv += std::to_string(i) + ",Z" + std::to_string(i % 313) + ",Z0,2024-01-01 " + zpad(i % 24, 2) + ":05,1,5\n";
+    }
+    csv += "7,ZTAIL,Z0,2024-01-01 04:00,1,5"; // no final newline
+    writeTripsCsv(csv);
+
+    TripAnalyzer fromFile;
+    fromFile.ingestFile("Trips.csv");
+
+    for (bool async : {false, true}) {
+        int fds[2];
+        REQUIRE(::pipe(fds) == 0);
+        std::thread writer([&] {
+            size_t off = 0;
+            while (off < csv.size()) {
+                ssize_t n = ::write(fds[1], csv.data() + off, std::min<size_t>(65536, csv.size() - off));
+                if (n <= 0) break;
+                off += (size_t)n;
+            }
+            ::close(fds[1]);
+        });
+        IngestOptions opts;
+        opts.asyncRead = async;
+        TripAnalyzer fromPipe;
+        fromPipe.ingestFd(fds[0], opts);
+        writer.join();
+        ::close(fds[0]);
+        requireSameResults(fromPipe, fromFile);
+    }
+
+    std::istringstream in(csv);
+    TripAnalyzer fromStream;
+    fromStream.ingestStream(in);
+    requireSameResults(fromStream, fromFile);
+}
+
+TEST_CASE_METHOD(TripsFixture, "D18 ingest stats count rows and rejects by reason", "[D]") {
+    const std::string csv =
+        "TripID,PickupZoneID,PickupTime\n"
+        "1,Z1,2024-01-01 07:00\n"
+        "2,z1,2024-01-01 08:30\r\n"
+        "3,Z2\n"                    // too few fields
+        "4,  ,2024-01-01 09:00\n"   // empty zone
+        "5,Z3,yesterday\n"          // no hour
+        "\n"
+        "6,Z3,2024-01-01 24:00\n"   // hour out of range
+        "7,Z3,13:00 PM\n";          // hour out of range
+    writeTripsCsv(csv);
+
+    IngestOptions lines, simd, getline;
+    simd.engine = CsvEngine::Simd;
+    getline.useMmap = false;
+    for (const IngestOptions& opts : {lines, simd, getline}) {
+        TripAnalyzer a;
+        a.ingestFile("Trips.csv", opts);
+        IngestStats st = a.ingestStats();
+#ifdef TRIP_ANALYZER_STATS
+        REQUIRE(st.enabled);
+        REQUIRE(st.bytesRead == (long long)csv.size());
+        REQUIRE(st.rowsSeen == 7);
+        REQUIRE(st.rowsAccepted == 2);
+        REQUIRE(st.rejectedFields == 1);
+        REQUIRE(st.rejectedEmptyZone == 1);
+        REQUIRE(st.rejectedBadTime == 1);
+        REQUIRE(st.rejectedHourRange == 2);
+        REQUIRE(st.zones == 1);
+        REQUIRE(st.loadFactor > 0.0);
+        REQUIRE(st.loadFactor <= 0.75);
+
+        // appends and merges add up
+        IngestOptions again = opts;
+        again.append = true;
+        a.ingestFile("Trips.csv", again);
+        TripAnalyzer b;
+        b.ingestFile("Trips.csv", opts);
+        a.mergeFrom(b);
+        REQUIRE(a.ingestStats().rowsSeen == 21);
+        REQUIRE(a.ingestStats().rowsAccepted == 6);
+#else
+        REQUIRE_FALSE(st.enabled);
+        REQUIRE(st.rowsSeen == 0);
+#endif
+    }
+
+#ifdef TRIP_ANALYZER_STATS
+    // enough rows for the sampled phases to be timed, on every engine
+    std::string many = "TripID,PickupZoneID,PickupTime\n";
+    for (int i = 0; i < 4096; i++) many += std::to_string(i) + ",Z" + std::to_string(i % 7) + ",2024-01-01 10:00\n";
+    writeTripsCsv(many);
+    for (const IngestOptions& opts : {lines, simd, getline}) {
+        TripAnalyzer a;
+        a.ingestFile("Trips.csv", opts);
+        IngestStats st = a.ingestStats();
+        REQUIRE(st.rowsAccepted == 4096);
+        REQUIRE(st.tokenizeMs > 0.0);
+        REQUIRE(st.hourMs > 0.0);
+        REQUIRE(st.hashMs > 0.0);
+    }
+#endif
+}
+
+TEST_CASE_METHOD(TripsFixture, "D19 sparse hour cells promote without changing counts", "[D]") {
+    // zone i sees i % 24 + 1 distinct hours: inline, just promoted and dense
+    std::string csv = "TripID,PickupZoneID,PickupTime\n";
+    std::map<std::pair<std::string, int>, long long> expected;
+    int id = 0;
+    for (int z = 0; z < 60; z++) {
+        std::string zone = "Z" + zpad(z, 2);
+        for (int h = 0; h <= z % 24; h++) {
+            int hour = (h * 7 + z) % 24;
+            for (int n = 0; n <= (z + h) % 3; n++) {
+                csv += std::to_string(++id) + "," + zone + ",2024-01-01 " + zpad(hour, 2) + ":00\n";
+                expected[{zone, hour}]++;
+            }
+        }
+    }
+    writeTripsCsv(csv);
+
+    SlotList slots;
+    for (const auto& kv : expected) slots.emplace_back(kv.first.first, kv.first.second, kv.second);
+
+    TripAnalyzer a;
+    a.ingestFile("Trips.csv");
+    requireSlotsEq(a.topBusySlots((int)slots.size() + 5), expectedTopSlots(slots));
+
+    // a snapshot keeps inline pairs and 32-bit rows as they are
+    auto cellsSnap = (fs::temp_directory_path() / "trip_d19_cells.snap").string();
+    REQUIRE(a.saveSnapshot(cellsSnap));
+    TripAnalyzer cellsLoaded;
+    REQUIRE(cellsLoaded.loadSnapshot(cellsSnap));
+    requireSameResults(cellsLoaded, a);
+    REQUIRE(cellsLoaded.memoryUsage().snapshot > 0);
+    REQUIRE(cellsLoaded.memoryUsage().snapshot <= fs::file_size(cellsSnap));
+    std::remove(cellsSnap.c_str());
+
+    // counters past 32 bits: self-merging doubles every count
+    writeTripsCsv("TripID,PickupZoneID,PickupTime\n"
+                  "1,ONE,2024-01-01 05:00\n"
+                  "2,MANY,2024-01-01 00:00\n3,MANY,2024-01-01 01:00\n4,MANY,2024-01-01 02:00\n"
+                  "5,MANY,2024-01-01 03:00\n6,MANY,2024-01-01 04:00\n");
+    TripAnalyzer big;
+    big.ingestFile("Trips.csv");
+    for (int i = 0; i < 33; i++) big.mergeFrom(big);
+    const long long c = 1LL << 33;
+    requireZonesEq(big.topZones(10), {{"MANY", 5 * c}, {"ONE", c}});
+    requireSlotsEq(big.topBusySlots(10),
+                   {{"MANY", 0, c}, {"MANY", 1, c}, {"MANY", 2, c}, {"MANY", 3, c}, {"MANY", 4, c}, {"ONE", 5, c}});
+
+    // snapshots keep the wide counts, and a write after loading thaws them
+    auto snap = (fs::temp_directory_path() / "trip_d19.snap").string();
+    REQUIRE(big.saveSnapshot(snap));
+    TripAnalyzer loaded;
+    REQUIRE(loaded.loadSnapshot(snap));
+    requireSameResults(loaded, big);
+    IngestOptions append;
+    append.append = true;
+    writeTripsCsv("TripID,PickupZoneID,PickupTime\n7,ONE,2024-01-01 05:00\n");
+    loaded.ingestFile("Trips.csv", append);
+    requireZonesEq(loaded.topZones(10), {{"MANY", 5 * c}, {"ONE", c + 1}});
+    std::remove(snap.c_str());
+
+    // zones seen in three hours or fewer need no dense row
+    writeTripsCsv("TripID,PickupZoneID,PickupTime\n1,A,2024-01-01 05:00\n2,B,2024-01-01 06:00\n"
+                  "3,B,2024-01-01 07:00\n4,B,2024-01-01 08:00\n");
+    TripAnalyzer few;
+    few.ingestFile("Trips.csv");
+    MemoryUsage sparse = few.memoryUsage();
+    REQUIRE(sparse.denseHours == 0);
+    REQUIRE(sparse.zoneCells > 0);
+    REQUIRE(sparse.zoneIndex > 0);
+    REQUIRE(sparse.total() >= sparse.zoneIndex + sparse.zoneNames + sparse.zoneCells);
+    REQUIRE(big.memoryUsage().denseHours > 0);
+
+    // byte counts for a known table: 1000 zones at one hour, one at four
+    std::string known = "TripID,PickupZoneID,PickupTime\n";
+    for (int z = 0; z < 1000; z++) known += std::to_string(z) + ",Z" + zpad(z, 4) + ",2024-01-01 10:00\n";
+    for (int h = 0; h < 4; h++) known += "9" + std::to_string(h) + ",BUSY,2024-01-01 0" + std::to_string(h) + ":00\n";
+    writeTripsCsv(known);
+    TripAnalyzer sized;
+    sized.ingestFile("Trips.csv");
+    MemoryUsage m = sized.memoryUsage();
+    const size_t zones = 1001, nameChars = 1000 * 5 + 4;
+    REQUIRE(m.zoneIndex == 2048 * 8);  // 8-byte slots, power of two, at most 3/4 full
+    REQUIRE(m.denseHours == 24 * 4);   // one promoted zone, 32-bit counters
+    REQUIRE(m.zoneCells >= zones * 24); // 24-byte cells, vector slack at most 2x
+    REQUIRE(m.zoneCells <= 2 * zones * 24);
+    REQUIRE(m.zoneNames >= nameChars + zones * 4); // packed names, 32-bit end offsets
+    REQUIRE(m.zoneNames <= 2 * (nameChars + zones * 4));
+    REQUIRE(m.snapshot == 0);
+    REQUIRE(m.rankingCache == 0);
+    REQUIRE(m.followBuffer == 0);
+    REQUIRE(m.total() == m.zoneIndex + m.zoneNames + m.zoneCells + m.denseHours);
+}
+
+TEST_CASE_METHOD(TripsFixture, "D20 hot-zone cache agrees with the index", "[D]") {
+    // unique zones first (the cache switches itself off), then a skewed
+    // tail where raw spellings of the same zone differ in case and padding
+    std::string csv = "TripID,PickupZoneID,PickupTime\n";
+    std::unordered_map<std::string, long long> expected;
+    int id = 0;
+    for (int i = 0; i < 5000; i++) {
+        csv += std::to_string(++id) + ",U" + zpad(i, 5) + ",2024-01-01 03:00\n";
+        expected["U" + zpad(i, 5)]++;
+    }
+    const char* const spellings[] = {"AIRPORT", "airport", " Airport ", "DOWNTOWN", "downtown", "HARBOR"};
+    const char* const canonical[] = {"AIRPORT", "AIRPORT", "AIRPORT", "DOWNTOWN", "DOWNTOWN", "HARBOR"};
+    for (int i = 0; i < 200000; i++) {
+        int k = (i % 7 == 6) ? 5 : i % 5;
+        if (i % 1000 == 999) {
+            csv += std::to_string(++id) + ",R" + std::to_string(i) + ",2024-01-01 04:00\n";
+            expected["R" + std::to_string(i)]++;
+            continue;
+        }
+        csv += std::to_string(++id) + "," + spellings[k] + ",2024-01-01 " + zpad(i % 24, 2) + ":00\n";
+        expected[canonical[k]]++;
+    }
+    writeTripsCsv(csv);
+
+    TripAnalyzer a;
+    a.ingestFile("Trips.csv");
+    requireZonesEq(a.topZones(10), expectedTopZones(expected, 10));
+
+#ifdef TRIP_ANALYZER_STATS
+    IngestStats st = a.ingestStats();
+    REQUIRE(st.frontCacheLookups < st.rowsAccepted); // off for part of the unique prefix
+    REQUIRE(st.frontCacheHitRate > 0.9);
+#endif
+}
+
+TEST_CASE("D21 canonical hour fast path agrees with the general parser", "[D]") {
+    // the fixed layout at a spread of hours, then every one-byte deletion,
+    // substitution and insertion of it, plus trailing garbage
+    std::vector<std::string> inputs;
+    for (char sep : {' ', 'T'}) {
+        for (const char* secs : {"", ":45"}) {
+            for (int h : {0, 1, 9, 10, 12, 13, 19, 20, 23, 24, 29, 30, 99}) {
+                inputs.push_back(std::string("2024-03-09") + sep + zpad(h, 2) + ":07" + secs);
+            }
+        }
+    }
+    const std::string alphabet = " :-T0159aAmMpP\t";
+    size_t canonical = inputs.size();
+    for (size_t b = 0; b < canonical; b++) {
+        const std::string base = inputs[b];
+        for (size_t i = 0; i <= base.size(); i++) {
+            if (i < base.size()) inputs.push_back(base.substr(0, i) + base.substr(i + 1));
+            for (char c : alphabet) {
+                if (i < base.size()) {
+                    std::string sub = base;
+                    sub[i] = c;
+                    inputs.push_back(sub);
+                }
+                inputs.push_back(base.substr(0, i) + c + base.substr(i));
+            }
+        }
+        for (const char* tail : {"X", " ", "0", ":", " PM", " am", ":00", "Z"}) inputs.push_back(base + tail);
+    }
+
+    size_t fast = 0;
+    std::vector<std::string> mismatches;
+    for (const auto& dt : inputs) {
+        int fastHour = -1, generalHour = -1, hour = -1;
+        HourParse result = HourParse::BadTime;
+        HourParse general = parseGeneralHour(dt, generalHour);
+        bool ok = general == HourParse::Ok;
+        if (parseCanonicalHour(dt, fastHour, result)) {
+            fast++;
+            if (result != general || (ok && fastHour != generalHour)) mismatches.push_back(dt);
+        }
+        if (parseHourFromDatetime(dt, hour) != general || (ok && hour != generalHour)) mismatches.push_back(dt);
+    }
+    INFO("inputs=" << inputs.size() << " fast=" << fast << " first mismatch: "
+                   << (mismatches.empty() ? std::string("-") : mismatches[0]));
+    REQUIRE(mismatches.empty());
+    REQUIRE(fast > canonical);           // near-misses that keep the shape went the fast way
+    REQUIRE(fast < inputs.size() / 2);   // the rest were left to the general parser
+}
+
+TEST_CASE_METHOD(TripsFixture, "D22 dense ids keep first-seen order and counts survive growth", "[D]") {
+    // ids are handed out in first-seen order and never move when the slot
+    // array grows; checked right after every growth
+    ZoneIndex index;
+    std::vector<std::string> keys;
+    size_t growths = 0, wrong = 0;
+    for (int i = 0; i < 40000; i++) {
+        std::string key = "K" + std::to_string((i * 7919) % 40000);
+        if (i % 4 == 1) key += std::string(30, 'L'); // compared against the stored name
+        size_t cap = index.capacity();
+        wrong += index.intern(key) != (uint32_t)keys.size();
+        keys.push_back(key);
+        wrong += index.intern(key) != (uint32_t)keys.size() - 1; // a repeat keeps its id
+        if (index.capacity() != cap) {
+            growths++;
+            for (size_t id = 0; id < keys.size(); id++) {
+                wrong += index.find(keys[id]) != (uint32_t)id || index.name((uint32_t)id) != keys[id];
+            }
+        }
+    }
+    REQUIRE(wrong == 0);
+    REQUIRE(growths >= 10);
+    REQUIRE(index.rehashes() == growths - 1); // the first allocation moves nothing
+
+    // counters indexed by id: zones come back round after many growths of
+    // the table, and every revisit must land on the zone's own counter
+    std::string csv = "TripID,PickupZoneID,PickupTime\n";
+    std::unordered_map<std::string, long long> expected;
+    int id = 0;
+    for (int round = 0; round < 3; round++) {
+        for (int z = 0; z < 20000; z++) {
+            if (round > 0 && z % (round + 1) != 0) continue;
+            std::string zone = "Z" + std::to_string(z);
+            csv += std::to_string(++id) + "," + zone + ",2024-01-01 " + zpad((z + round) % 24, 2) + ":00\n";
+            expected[zone]++;
+        }
+    }
+    writeTripsCsv(csv);
+
+    TripAnalyzer a;
+    a.ingestFile("Trips.csv");
+    requireZonesEq(a.topZones((int)expected.size()), expectedTopZones(expected));
+}
+
+TEST_CASE_METHOD(TripsFixture, "D23 block readers match the mapped reader with 7-byte blocks", "[D]") {
+    // blocks shorter than almost every line: each line, quote and CRLF pair
+    // straddles at least one block edge and is stitched from the carry
+    std::string csv = std::string("\r\n") + kDirtyWideCsv + "\n";
+    for (int i = 0; i < 1500; i++) {
+        csv += std::to_string(i) + (i % 4 == 0 ? ",\"Z,\"\"" + std::to_string(i % 9) + "\"" : ",Z" + std::to_string(i % 31));
+        csv += ",Z0,2024-01-01 " + zpad(i % 24, 2) + (i % 11 == 0 ? ":00,1.0\n" : ":00,1.0,5.0");
+        csv += (i % 3 == 0) ? "\r\n" : "\n";
+        if (i % 100 == 0) csv += "\n\r\n";
+    }
+    csv += "9999,ZLAST,Z0,2024-01-01 23:00,1.0,5.0"; // no final newline
+    writeTripsCsv(csv);
+
+    TripAnalyzer mapped;
+    mapped.ingestFile("Trips.csv");
+    REQUIRE(mapped.topZones(1).size() == 1);
+
+    for (size_t block : {(size_t)7, (size_t)1, (size_t)4099}) {
+        for (CsvEngine engine : {CsvEngine::Lines, CsvEngine::Simd}) {
+            INFO("block=" << block << " simd=" << (engine == CsvEngine::Simd));
+            IngestOptions opts;
+            opts.readBlockBytes = block;
+            opts.engine = engine;
+
+            std::istringstream in(csv);
+            TripAnalyzer fromStream;
+            fromStream.ingestStream(in, opts);
+            requireSameResults(fromStream, mapped);
+
+            for (bool async : {false, true}) {
+                opts.asyncRead = async;
+                int fd = ::open("Trips.csv", O_RDONLY);
+                REQUIRE(fd >= 0);
+                TripAnalyzer fromFd;
+                fromFd.ingestFd(fd, opts);
+                ::close(fd);
+                requireSameResults(fromFd, mapped);
+            }
+
+            opts.useMmap = false;
+            opts.asyncRead = true;
+            TripAnalyzer async;
+            async.ingestFile("Trips.csv", opts);
+            requireSameResults(async, mapped);
+        }
+    }
+}
+
+// Runs the dataset generator built next to the tests; returns its exit status.
+static int runGenTrips(const fs::path& binDir, const std::string& args) {
+    std::string cmd = (binDir / "gen_trips").string() + " " + args + " 2>/dev/null";
+    return std::system(cmd.c_str());
+}
+
+static std::string readFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+TEST_CASE_METHOD(TripsFixture, "D24 gen_trips writes the requested rows, layout and bytes", "[D]") {
+    if (!fs::exists(oldCwd / "gen_trips")) SKIP("gen_trips is not built (make gen)");
+
+    REQUIRE(runGenTrips(oldCwd, "--rows 2000 --zones 50 --columns 3 --seed 7 -o a.csv") == 0);
+    REQUIRE(runGenTrips(oldCwd, "--rows 2000 --zones 50 --columns 3 --seed 7 -o b.csv") == 0);
+    REQUIRE(runGenTrips(oldCwd, "--rows 2000 --zones 50 --columns 3 --seed 8 -o c.csv") == 0);
+    REQUIRE(runGenTrips(oldCwd, "--rows 2000 --zones 50 --columns 6 --seed 7 -o wide.csv") == 0);
+    REQUIRE(readFile("a.csv") == readFile("b.csv"));
+    REQUIRE(readFile("a.csv") != readFile("c.csv"));
+
+    // a header, then one line per row with the layout's field count
+    struct Layout {
+        const char* path;
+        const char* header;
+        size_t fields;
+    };
+    for (const Layout& l : {Layout{"a.csv", "TripID,PickupZoneID,PickupTime", 3},
+                            Layout{"wide.csv", "TripID,PickupZoneID,DropoffZoneID,PickupDateTime,DistanceKm,FareAmount", 6}}) {
+        INFO(l.path);
+        std::ifstream in(l.path);
+        std::string line;
+        REQUIRE(std::getline(in, line));
+        REQUIRE(line == l.header);
+        size_t rows = 0, badFields = 0;
+        CsvTokenizer tok;
+        while (std::getline(in, line)) {
+            rows++;
+            badFields += tok.split(line) != l.fields;
+        }
+        REQUIRE(rows == 2000);
+        REQUIRE(badFields == 0);
+
+        // clean rows are all valid trips
+        TripAnalyzer a;
+        a.ingestFile(l.path);
+        auto zones = a.topZones(1000);
+        REQUIRE(zones.size() <= 50);
+        long long total = 0;
+        for (const auto& z : zones) total += z.count;
+        REQUIRE(total == 2000);
+    }
+
+    // hot:p gives the hot zone share p, not p plus a background share
+    REQUIRE(runGenTrips(oldCwd, "--rows 20000 --zones 4 --dist hot:0.3 --columns 3 -o hot.csv") == 0);
+    TripAnalyzer hot;
+    hot.ingestFile("hot.csv");
+    double share = (double)hot.topZones(1)[0].count / 20000.0;
+    INFO("hot share " << share);
+    REQUIRE(share > 0.27);
+    REQUIRE(share < 0.33);
+
+    // a write error (here: a full device) is a failed run, not a short file
+    if (fs::exists("/dev/full")) REQUIRE(runGenTrips(oldCwd, "--rows 10 -o /dev/full") != 0);
+}
+
+TEST_CASE_METHOD(TripsFixture, "D25 zones longer than the front cache holds are counted by name", "[D]") {
+    // 255 bytes is the length the cache uses to mark an empty slot; the
+    // others sit on either side of its 27-byte limit and of 255
+    std::string csv = "TripID,PickupZoneID,PickupTime\n";
+    std::map<std::string, long long> expected;
+    const size_t lengths[] = {1, 26, 27, 28, 254, 255, 256, 300};
+    int id = 0;
+    for (int i = 0; i < 3000; i++) {
+        size_t len = lengths[i * 7 % 8];
+        std::string zone = "Z" + std::to_string(i % 3) + std::string(len, 'X');
+        zone.resize(len);
+        csv += std::to_string(++id) + "," + zone + ",2024-01-01 " + zpad(i % 24, 2) + ":00\n";
+        expected[zone]++;
+    }
+    writeTripsCsv(csv);
+
+    IngestOptions lines, simd;
+    simd.engine = CsvEngine::Simd;
+    for (const IngestOptions& opts : {lines, simd}) {
+        TripAnalyzer a;
+        a.ingestFile("Trips.csv", opts);
+        requireZonesEq(a.topZones(100), expectedTopZones(expected));
+    }
+
+    // A 255-byte zone whose bytes are what a fresh cache holds from its
+    // slot's key on: 27 zero bytes, then empty slots (id 0, length 0xFF,
+    // zero key). Unguarded, it "hits" its empty slot and counts as id 0
+    // (ZONE's slot is not among the ones it runs over).
+    std::string empty(27, '\0');
+    while (empty.size() < 255) empty += std::string(4, '\0') + '\xFF' + std::string(27, '\0');
+    empty.resize(255);
+    writeTripsCsv("TripID,PickupZoneID,PickupTime\n1,ZONE,2024-01-01 05:00\n2," + empty + ",2024-01-01 06:00\n");
+    TripAnalyzer a;
+    a.ingestFile("Trips.csv");
+    requireZonesEq(a.topZones(10), expectedTopZones(std::map<std::string, long long>{{"ZONE", 1}, {empty, 1}}));
+}
+
+TEST_CASE_METHOD(TripsFixture, "D26 both engines count and reject the same dirty rows", "[D]") {
+    // rows with no fields at all, short and quoted rows, blank lines and a
+    // last line without '\n', spread so some cross 64-byte blocks
+    std::string csv = "TripID,PickupZoneID,PickupTime\r\n";
+    for (int i = 0; i < 300; i++) {
+        switch (i % 7) {
+        case 0: csv += "\"\"\n"; break;
+        case 1: csv += "\"\"\r\n"; break;
+        case 2: csv += std::to_string(i) + ",\"Z" + std::to_string(i % 5) + "\",2024-01-01 07:00\n"; break;
+        case 3: csv += std::to_string(i) + ",Z1\n"; break;
+        case 4: csv += "\r\n\n"; break;
+        case 5: csv += std::to_string(i) + ",,2024-01-01 08:00\n"; break;
+        default: csv += std::to_string(i) + ",Z" + std::to_string(i % 3) + ",2024-01-01 " + zpad(i % 30, 2) + ":00\n";
+        }
+    }
+    csv += "\"\"";
+    writeTripsCsv(csv);
+
+    IngestOptions lines, simd;
+    simd.engine = CsvEngine::Simd;
+    TripAnalyzer a, b;
+    a.ingestFile("Trips.csv", lines);
+    b.ingestFile("Trips.csv", simd);
+    requireSameResults(a, b);
+
+    IngestStats sa = a.ingestStats(), sb = b.ingestStats();
+#ifdef TRIP_ANALYZER_STATS
+    REQUIRE(sa.rejectedFields == 2 * 43 + 43 + 1); // `""` rows, short rows, the last line
+#endif
+    REQUIRE(sa.rowsSeen == sb.rowsSeen);
+    REQUIRE(sa.rowsAccepted == sb.rowsAccepted);
+    REQUIRE(sa.rejectedFields == sb.rejectedFields);
+    REQUIRE(sa.rejectedEmptyZone == sb.rejectedEmptyZone);
+    REQUIRE(sa.rejectedBadTime == sb.rejectedBadTime);
+    REQUIRE(sa.rejectedHourRange == sb.rejectedHourRange);
+}
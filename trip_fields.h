@@ -0,0 +1,107 @@
+#pragma once
+#include <cctype>
+#include <string_view>
+
+// Field-level parsing shared by the ingest paths: trimming and reading the
+// hour of day from a pickup time. Everything works on views and is inline,
+// since it runs once or twice per row.
+
+inline std::string_view trimView(std::string_view s) {
+    size_t b = 0;
+    while (b < s.size() && std::isspace((unsigned char)s[b])) ++b;
+    size_t e = s.size();
+    while (e > b && std::isspace((unsigned char)s[e - 1])) --e;
+    return s.substr(b, e - b);
+}
+
+// Case-insensitive substring test for short ASCII needles.
+inline bool containsNoCase(std::string_view hay, std::string_view needle) {
+    if (needle.size() > hay.size()) return false;
+    for (size_t i = 0; i + needle.size() <= hay.size(); ++i) {
+        size_t j = 0;
+        while (j < needle.size() &&
+               std::toupper((unsigned char)hay[i + j]) == (unsigned char)needle[j]) ++j;
+        if (j == needle.size()) return true;
+    }
+    return false;
+}
+
+// What reading an hour came to. The two failures are counted apart by the
+// ingest statistics: no hour at all, or an hour outside 0-23 (1-12 with
+// AM/PM).
+enum class HourParse { Ok, BadTime, OutOfRange };
+
+inline bool isDigitAt(std::string_view s, size_t i) {
+    return (unsigned)(s[i] - '0') < 10u;
+}
+
+// Fast path for the canonical "YYYY-MM-DD HH:MM" (also 'T' and ":SS") shape:
+// fixed-offset byte checks, hour read straight from bytes 11-12. An all-digit
+// timestamp cannot contain AM/PM, so the general parser would agree exactly.
+// Returns false when dt does not have that shape; `result` is the verdict.
+inline bool parseCanonicalHour(std::string_view dt, int& hourOut, HourParse& result) {
+    if (dt.size() != 16 && dt.size() != 19) return false;
+    if (dt[4] != '-' || dt[7] != '-' || dt[13] != ':') return false;
+    if (dt[10] != ' ' && dt[10] != 'T') return false;
+    static const unsigned char kDigits[] = {0, 1, 2, 3, 5, 6, 8, 9, 11, 12, 14, 15};
+    for (unsigned char i : kDigits) {
+        if (!isDigitAt(dt, i)) return false;
+    }
+    if (dt.size() == 19 && (dt[16] != ':' || !isDigitAt(dt, 17) || !isDigitAt(dt, 18))) return false;
+
+    int h = (dt[11] - '0') * 10 + (dt[12] - '0');
+    result = h <= 23 ? HourParse::Ok : HourParse::OutOfRange;
+    if (h <= 23) hourOut = h;
+    return true;
+}
+
+// General parser for any other shape.
+// Accepts: "YYYY-MM-DD HH:MM", "YYYY-MM-DDTHH:MM", "YYYY-MM-DD HH:MM:SS", etc.
+// Strategy: find first ':' and extract the 1-2 digit hour immediately before it.
+inline HourParse parseGeneralHour(std::string_view dt, int& hourOut) {
+    dt = trimView(dt);
+    if (dt.empty()) return HourParse::BadTime;
+
+    size_t colon = dt.find(':');
+    if (colon == std::string_view::npos || colon == 0) return HourParse::BadTime;
+
+    size_t end = colon - 1;
+    size_t start = end;
+    while (start > 0 && std::isdigit((unsigned char)dt[start - 1])) --start;
+
+    std::string_view hStr = dt.substr(start, end - start + 1);
+    if (hStr.empty() || hStr.size() > 2) return HourParse::BadTime;
+
+    int h = 0;
+    for (char c : hStr) {
+        if (!std::isdigit((unsigned char)c)) return HourParse::BadTime;
+        h = h * 10 + (c - '0');
+    }
+
+    bool hasAm = containsNoCase(dt, "AM");
+    bool hasPm = containsNoCase(dt, "PM");
+
+    if (hasAm || hasPm) {
+        // 12-hour format
+        if (h < 1 || h > 12) return HourParse::OutOfRange;
+        if (hasPm) {
+            if (h != 12) h += 12;
+        } else { // AM
+            if (h == 12) h = 0;
+        }
+    } else {
+        // 24-hour format
+        if (h < 0 || h > 23) return HourParse::OutOfRange;
+    }
+
+    hourOut = h;
+    return HourParse::Ok;
+}
+
+// Parse hour from a datetime string robustly: the canonical shape through
+// the fast path, anything else through the general parser.
+inline HourParse parseHourFromDatetime(std::string_view dt, int& hourOut) {
+    HourParse result = HourParse::BadTime;
+    if (parseCanonicalHour(dt, hourOut, result)) return result;
+    return parseGeneralHour(dt, hourOut);
+}
@@ -0,0 +1,43 @@
+#include "zone_index.h"
+
+uint32_t ZoneIndex::insertAt(Slot& slot, std::string_view key, uint32_t h) {
+    if (key.size() > UINT32_MAX - names_.size()) throw std::length_error("ZoneIndex: zone names exceed 4 GiB");
+    uint32_t id = size();
+    names_.append(key.data(), key.size());
+    nameEnds_.push_back((uint32_t)names_.size());
+
+    slot.hash = h;
+    slot.id = id;
+    return id;
+}
+
+void ZoneIndex::grow() {
+    reserve(slots_.empty() ? 8 : slots_.size());
+}
+
+void ZoneIndex::reserve(size_t n) {
+    size_t cap = 16;
+    while (cap * 3 < (n + 1) * 4) cap *= 2;
+    if (cap <= slots_.size()) return;
+
+    std::vector<Slot> old;
+    old.swap(slots_);
+    Slot empty{};
+    empty.id = kNotFound;
+    slots_.assign(cap, empty);
+    mask_ = cap - 1;
+    if (!old.empty()) rehashes_++;
+
+    // hashes are stored, so moving a slot never rereads its key
+    for (const Slot& s : old) {
+        if (s.id != kNotFound) emptySlotFor(s.hash) = s;
+    }
+}
+
+void ZoneIndex::clear() {
+    slots_.clear();
+    mask_ = 0;
+    rehashes_ = 0;
+    names_.clear();
+    nameEnds_.clear();
+}
@@ -0,0 +1,118 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Maps zone strings to dense ids (0, 1, 2, ... in first-seen order).
+//
+// Open addressing with linear probing over 8-byte slots holding the key's
+// 32-bit hash and its id; a slot whose hash matches is confirmed against the
+// id's stored name. Keys are not copied into the slots: with a million
+// zones the slot array is most of the index, and hot zones are found by the
+// analyzer's front cache before they get here. Lookups take a string_view:
+// probing never builds a std::string. Names are packed end to end in one
+// buffer (at most 4 GiB) with a 32-bit end offset per id.
+class ZoneIndex {
+public:
+    static const uint32_t kNotFound = UINT32_MAX;
+
+    // Id of `key`, assigning the next id if it is new. Only an insert can
+    // grow the slot array; looking up a known key never rehashes.
+    uint32_t intern(std::string_view key) {
+        uint32_t h = hashKey(key);
+        if (slots_.empty()) grow();
+
+        size_t i = h & mask_;
+        for (;;) {
+            Slot& slot = slots_[i];
+            if (slot.id == kNotFound) {
+                if (!needsGrow()) return insertAt(slot, key, h);
+                grow();
+                return insertAt(emptySlotFor(h), key, h);
+            }
+            if (slot.hash == h && keyEquals(slot, key)) return slot.id;
+            i = (i + 1) & mask_;
+        }
+    }
+
+    // Id of `key`, or kNotFound.
+    uint32_t find(std::string_view key) const {
+        if (slots_.empty()) return kNotFound;
+        uint32_t h = hashKey(key);
+        size_t i = h & mask_;
+        for (;;) {
+            const Slot& slot = slots_[i];
+            if (slot.id == kNotFound) return kNotFound;
+            if (slot.hash == h && keyEquals(slot, key)) return slot.id;
+            i = (i + 1) & mask_;
+        }
+    }
+
+    uint32_t size() const { return (uint32_t)nameEnds_.size(); }
+    std::string_view name(uint32_t id) const {
+        size_t begin = id ? nameEnds_[id - 1] : 0;
+        return std::string_view(names_.data() + begin, nameEnds_[id] - begin);
+    }
+
+    // Slot count, and how often existing keys were moved to a larger array.
+    size_t capacity() const { return slots_.size(); }
+    size_t rehashes() const { return rehashes_; }
+
+    // True if interning a new key grows the slot array first.
+    bool needsGrow() const { return slots_.empty() || (size() + 1) * 4 > slots_.size() * 3; }
+
+    // Heap bytes held by the slot array and by the names.
+    size_t slotBytes() const { return slots_.capacity() * sizeof(Slot); }
+    size_t nameBytes() const { return names_.capacity() + nameEnds_.capacity() * sizeof(uint32_t); }
+
+    // Makes room for n keys without rehashing.
+    void reserve(size_t n);
+    void clear();
+
+private:
+    struct Slot {
+        uint32_t hash;
+        uint32_t id; // kNotFound marks an empty slot
+    };
+
+    static uint32_t hashKey(std::string_view key) {
+        // 8 bytes per round, multiply-xorshift mix; zone ids are short
+        const char* p = key.data();
+        size_t n = key.size();
+        uint64_t h = 0x9E3779B97F4A7C15ull ^ n;
+        while (n >= 8) {
+            uint64_t w;
+            std::memcpy(&w, p, 8);
+            h = (h ^ w) * 0xFF51AFD7ED558CCDull;
+            h ^= h >> 32;
+            p += 8;
+            n -= 8;
+        }
+        uint64_t w = 0; // byte loop: a variable-length memcpy is a library call
+        for (size_t i = 0; i < n; ++i) w |= (uint64_t)(uint8_t)p[i] << (8 * i);
+        h = (h ^ w) * 0xC4CEB9FE1A85EC53ull;
+        h ^= h >> 29;
+        return (uint32_t)h;
+    }
+
+    bool keyEquals(const Slot& slot, std::string_view key) const { return name(slot.id) == key; }
+
+    Slot& emptySlotFor(uint32_t h) {
+        size_t i = h & mask_;
+        while (slots_[i].id != kNotFound) i = (i + 1) & mask_;
+        return slots_[i];
+    }
+
+    uint32_t insertAt(Slot& slot, std::string_view key, uint32_t h);
+    void grow();
+
+    std::vector<Slot> slots_; // power-of-two sized, at most 3/4 full
+    size_t mask_ = 0;
+    size_t rehashes_ = 0;
+    std::string names_;              // every key, in id order
+    std::vector<uint32_t> nameEnds_; // id -> end of its key in names_
+};